@@ -0,0 +1,71 @@
+// AudioClock.cpp
+#include "AudioClock.h"
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+AudioClock::AudioClock()
+    : sequence(0)
+    , anchorPts(0.0)
+    , limitPts(0.0)
+    , anchorTime(0)
+    , running(false) {
+}
+
+void AudioClock::update(double pts, double limit, int64_t timeMicros, bool isRunning) {
+    // Odd while the fields change; readers retry until it is even again
+    uint32_t start = sequence.load(std::memory_order_relaxed);
+    sequence.store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    anchorPts.store(pts, std::memory_order_relaxed);
+    limitPts.store(std::max(pts, limit), std::memory_order_relaxed);
+    anchorTime.store(timeMicros, std::memory_order_relaxed);
+    running.store(isRunning, std::memory_order_relaxed);
+
+    sequence.store(start + 2, std::memory_order_release);
+}
+
+void AudioClock::set(double pts) {
+    update(pts, pts, av_gettime_relative(), false);
+}
+
+void AudioClock::pause() {
+    int64_t now = av_gettime_relative();
+    update(read(now), limitPts.load(std::memory_order_relaxed), now, false);
+}
+
+void AudioClock::resume() {
+    update(anchorPts.load(std::memory_order_relaxed), limitPts.load(std::memory_order_relaxed),
+        av_gettime_relative(), true);
+}
+
+double AudioClock::get() const {
+    return read(av_gettime_relative());
+}
+
+double AudioClock::read(int64_t timeMicros) const {
+    for (;;) {
+        uint32_t start = sequence.load(std::memory_order_acquire);
+        if (start & 1) {
+            continue;
+        }
+
+        double pts = anchorPts.load(std::memory_order_relaxed);
+        double limit = limitPts.load(std::memory_order_relaxed);
+        int64_t time = anchorTime.load(std::memory_order_relaxed);
+        bool isRunning = running.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != start) {
+            continue;
+        }
+
+        if (!isRunning) {
+            return pts;
+        }
+        return std::min(limit, pts + (timeMicros - time) / 1000000.0);
+    }
+}
@@ -0,0 +1,39 @@
+// AudioClock.h
+#ifndef AUDIOCLOCK_H
+#define AUDIOCLOCK_H
+
+#include <atomic>
+#include <cstdint>
+
+// Time of the sample currently leaving the speakers. The audio callback
+// anchors it whenever it hands samples to the device; in between it runs
+// on the monotonic timer, but never past the last sample handed over.
+// Updates come from one writer at a time (the callback, or a control
+// thread holding the device lock) and are published through a sequence
+// lock, so any thread reads it without locking.
+class AudioClock {
+public:
+    AudioClock();
+
+    // Writer side. pts is the audible time at timeMicros, limit the time
+    // of the last sample queued to the device
+    void update(double pts, double limit, int64_t timeMicros, bool running);
+    void set(double pts);       // Stopped at pts, e.g. after a seek
+    void pause();
+    void resume();
+
+    // Reader side, any thread
+    double get() const;
+    bool isRunning() const { return running.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> sequence;
+    std::atomic<double> anchorPts;
+    std::atomic<double> limitPts;
+    std::atomic<int64_t> anchorTime;
+    std::atomic<bool> running;
+
+    double read(int64_t timeMicros) const;
+};
+
+#endif // AUDIOCLOCK_H
@@ -1,64 +1,112 @@
 // AudioDecoder.cpp
 #include "AudioDecoder.h"
+#include "Tracer.h"
+#include "Logger.h"
+#include "ProcessStats.h"
 #include <iostream>
 #include <algorithm>
 #include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+
+namespace {
+// How long the decoding thread waits for a packet before rechecking state
+const int PACKET_WAIT_MS = 20;
+
+// Decoded audio buffered ahead of the device, and how long the decoding
+// thread sleeps when that is full
+const int SAMPLE_RING_MS = 500;
+const int RING_FULL_WAIT_MS = 5;
+
+// Output is interleaved 16-bit stereo
+const int OUTPUT_CHANNELS = 2;
+const size_t BYTES_PER_SAMPLE = OUTPUT_CHANNELS * sizeof(int16_t);
+
+// Audio following another clock is corrected when it drifts beyond the
+// threshold, by at most this share of each frame; past the no-sync limit
+// it is left alone
+const double AUDIO_DRIFT_THRESHOLD = 0.03;
+const double AUDIO_NOSYNC_THRESHOLD = 10.0;
+const int MAX_CORRECTION_PERCENT = 10;
+
+// Device buffer sizes of the fixed latency profiles, in sample frames
+const int LATENCY_FRAMES[] = { 256, 512, 1024, 4096 };
+
+// The adaptive buffer starts here and doubles up to the maximum, at most
+// once per interval so that one stall does not take it all the way
+const int ADAPTIVE_START_FRAMES = 512;
+const int ADAPTIVE_MAX_FRAMES = 4096;
+const int64_t ADAPTIVE_RESIZE_INTERVAL_US = 1000000;
+
+int bufferFramesFor(AudioLatency latency) {
+    if (latency == AudioLatency::Adaptive) {
+        return ADAPTIVE_START_FRAMES;
+    }
+    return LATENCY_FRAMES[(int)latency];
+}
+}
 
 AudioDecoder::AudioDecoder()
-    : formatContext(nullptr)
+    : demuxer(nullptr)
+    , packetQueue(nullptr)
     , codecContext(nullptr)
     , audioStream(nullptr)
     , swrContext(nullptr)
+    , packet(nullptr)
+    , decodedFrame(nullptr)
     , sampleRate(0)
     , channels(0)
     , duration(0)
-    , audioStreamIndex(-1)
+    , packetSerial(-1)
+    , bitexact(false)
     , audioDevice(0)
+    , latency(AudioLatency::High)
+    , deviceBufferFrames(0)
+    , underrunCount(0)
+    , underrunArmed(false)
+    , adaptedUnderruns(0)
+    , lastResizeTime(0)
+    , latencyResizes(0)
     , isDecoding(false)
     , playbackStarted(false)
     , playbackPaused(false)
     , shouldStop(false)
-    , currentTime(0.0)
-    , bufferPosition(0) {
+    , endOfStream(false)
+    , playbackSerial(0)
+    , seekTarget(-DBL_MAX)
+    , syncDrift(0.0)
+    , firstSampleTime(-1)
+    , callbackCount(0)
+    , shortCallbackCount(0)
+    , callbackTicks(0)
+    , worstCallbackTicks(0) {
 }
 
 AudioDecoder::~AudioDecoder() {
     close();
 }
 
-bool AudioDecoder::openFile(const std::string& filename) {
-    std::cout << "Opening audio file: " << filename << std::endl;
+bool AudioDecoder::openStream(Demuxer& source) {
+    std::cout << "Opening audio stream" << std::endl;
 
-    // Close any existing file
+    // Close any existing stream
     close();
 
-    // Open input file
-    if (avformat_open_input(&formatContext, filename.c_str(), nullptr, nullptr) < 0) {
-        std::cerr << "Could not open audio file: " << filename << std::endl;
-        return false;
-    }
-
-    // Find stream information
-    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
-        std::cerr << "Could not find stream information" << std::endl;
-        avformat_close_input(&formatContext);
-        return false;
-    }
-
     // Find audio stream
-    audioStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
-    if (audioStreamIndex < 0) {
+    audioStream = source.getStream(AVMEDIA_TYPE_AUDIO);
+    if (!audioStream) {
         std::cerr << "Could not find audio stream" << std::endl;
-        avformat_close_input(&formatContext);
         return false;
     }
 
-    audioStream = formatContext->streams[audioStreamIndex];
+    demuxer = &source;
+    firstSampleTime = -1;
 
     // Get audio properties
     sampleRate = audioStream->codecpar->sample_rate;
     channels = audioStream->codecpar->channels;
-    duration = formatContext->duration;
+    duration = demuxer->getFormatContext()->duration;
 
     std::cout << "Audio format: " << sampleRate << "Hz, " << channels << " channels" << std::endl;
 
@@ -72,6 +120,22 @@ bool AudioDecoder::openFile(const std::string& filename) {
         return false;
     }
 
+    packet = av_packet_alloc();
+    decodedFrame = av_frame_alloc();
+    if (!packet || !decodedFrame) {
+        std::cerr << "Could not allocate audio packet/frame" << std::endl;
+        close();
+        return false;
+    }
+
+    // Start receiving packets from the shared demuxer
+    packetQueue = demuxer->attachStream(AVMEDIA_TYPE_AUDIO);
+    if (!packetQueue) {
+        std::cerr << "Could not attach to audio packet queue" << std::endl;
+        close();
+        return false;
+    }
+
     std::cout << "Audio decoder initialized successfully" << std::endl;
     return true;
 }
@@ -97,6 +161,10 @@ bool AudioDecoder::initializeDecoder() {
         return false;
     }
 
+    if (bitexact) {
+        codecContext->flags |= AV_CODEC_FLAG_BITEXACT;
+    }
+
     // Open codec
     if (avcodec_open2(codecContext, codec, nullptr) < 0) {
         std::cerr << "Could not open audio codec" << std::endl;
@@ -133,17 +201,66 @@ bool AudioDecoder::setupResampler() {
     return true;
 }
 
-bool AudioDecoder::startPlayback() {
+bool AudioDecoder::startPlayback(bool openDevice) {
     if (playbackStarted) {
         return true;
     }
 
+    // Start from an empty ring; only samples decoded from now on play.
+    // Decoding starts first so the ring fills while the device opens.
+    if (!sampleRing.init(sampleRate, OUTPUT_CHANNELS, SAMPLE_RING_MS)) {
+        std::cerr << "Could not allocate audio sample ring" << std::endl;
+        return false;
+    }
+    playbackSerial = packetQueue->getSerial();
+
+    // Start decoding thread
+    isDecoding = true;
+    shouldStop = false;
+    playbackPaused = false;
+    endOfStream = false;
+    decoderThread = std::thread(&AudioDecoder::decodingLoop, this);
+
+    if (!openDevice) {
+        // Samples are pulled straight from the ring, with no device delay
+        SDL_zero(audioSpec);
+        audioSpec.freq = sampleRate;
+        audioSpec.format = AUDIO_S16SYS;
+        audioSpec.channels = OUTPUT_CHANNELS;
+        playbackStarted = true;
+        std::cout << "Audio decoding started without a device" << std::endl;
+        return true;
+    }
+
     // Setup SDL Audio
+    underrunCount = 0;
+    underrunArmed = false;
+    adaptedUnderruns = 0;
+    latencyResizes = 0;
+    if (!openAudioDevice(bufferFramesFor(latency))) {
+        shouldStop = true;
+        isDecoding = false;
+        decoderThread.join();
+        sampleRing.clear();
+        return false;
+    }
+    lastResizeTime = av_gettime_relative();
+
+    // Start SDL audio playback
+    SDL_PauseAudioDevice(audioDevice, 0);
+
+    playbackStarted = true;
+    std::cout << "Audio playback started" << std::endl;
+    return true;
+}
+
+bool AudioDecoder::openAudioDevice(int bufferFrames) {
     SDL_AudioSpec desired;
+    SDL_zero(desired);
     desired.freq = sampleRate;
     desired.format = AUDIO_S16SYS;
-    desired.channels = 2; // Force stereo output
-    desired.samples = 4096;
+    desired.channels = OUTPUT_CHANNELS; // Force stereo output
+    desired.samples = (Uint16)bufferFrames;
     desired.callback = audioCallback;
     desired.userdata = this;
 
@@ -154,27 +271,82 @@ bool AudioDecoder::startPlayback() {
     }
 
     std::cout << "Audio device opened: " << audioSpec.freq << "Hz, "
-        << (int)audioSpec.channels << " channels" << std::endl;
-
-    // Clear any existing audio data
-    clearQueue();
-    audioBuffer.clear();
-    bufferPosition = 0;
+        << (int)audioSpec.channels << " channels, " << audioSpec.samples << " frame buffer ("
+        << audioSpec.samples * 1000.0 / audioSpec.freq << "ms, "
+        << getLatencyName(latency) << " latency)" << std::endl;
+    deviceBufferFrames = audioSpec.samples;
+    return true;
+}
 
-    // Start decoding thread
-    isDecoding = true;
-    shouldStop = false;
-    playbackPaused = false;
-    decoderThread = std::thread(&AudioDecoder::decodingLoop, this);
+bool AudioDecoder::adaptLatency() {
+    if (latency != AudioLatency::Adaptive || audioDevice == 0 || audioSpec.samples >= ADAPTIVE_MAX_FRAMES) {
+        return false;
+    }
 
-    // Start SDL audio playback
-    SDL_PauseAudioDevice(audioDevice, 0);
+    uint64_t underruns = underrunCount;
+    int64_t now = av_gettime_relative();
+    if (underruns == adaptedUnderruns || now - lastResizeTime < ADAPTIVE_RESIZE_INTERVAL_US) {
+        return false;
+    }
+    adaptedUnderruns = underruns;
+    lastResizeTime = now;
+
+    // SDL cannot resize an open device's buffer, so it is reopened; the
+    // samples waiting in the ring are kept
+    int previousFrames = audioSpec.samples;
+    int frames = std::min(previousFrames * 2, ADAPTIVE_MAX_FRAMES);
+    SDL_CloseAudioDevice(audioDevice);
+    audioDevice = 0;
+    deviceBufferFrames = 0;
+    underrunArmed = false;
+    if (!openAudioDevice(frames) && !openAudioDevice(previousFrames)) {
+        LOG_ERROR("Audio device lost while growing its buffer");
+        return false;
+    }
+    if (!playbackPaused) {
+        SDL_PauseAudioDevice(audioDevice, 0);
+    }
 
-    playbackStarted = true;
-    std::cout << "Audio playback started" << std::endl;
+    latencyResizes++;
+    LOG_INFO("Audio underrun: device buffer grown to %d frames (%.1fms)",
+        (int)audioSpec.samples, audioSpec.samples * 1000.0 / audioSpec.freq);
     return true;
 }
 
+AudioLatencyStats AudioDecoder::getLatencyStats() const {
+    AudioLatencyStats stats;
+    stats.bufferFrames = deviceBufferFrames;
+    stats.latencyMs = sampleRate > 0 ? stats.bufferFrames * 1000.0 / sampleRate : 0.0;
+    stats.underruns = underrunCount;
+    stats.resizes = latencyResizes;
+    return stats;
+}
+
+const char* AudioDecoder::getLatencyName(AudioLatency profile) {
+    switch (profile) {
+    case AudioLatency::Lowest: return "lowest";
+    case AudioLatency::Low: return "low";
+    case AudioLatency::Medium: return "medium";
+    case AudioLatency::High: return "high";
+    case AudioLatency::Adaptive: return "adaptive";
+    default: return "unknown";
+    }
+}
+
+bool AudioDecoder::parseLatency(const std::string& name, AudioLatency& profile) {
+    if (name == "adaptive") {
+        profile = AudioLatency::Adaptive;
+        return true;
+    }
+    for (int i = 0; i < (int)(sizeof(LATENCY_FRAMES) / sizeof(LATENCY_FRAMES[0])); i++) {
+        if (name == std::to_string(LATENCY_FRAMES[i])) {
+            profile = (AudioLatency)i;
+            return true;
+        }
+    }
+    return false;
+}
+
 void AudioDecoder::stopPlayback() {
     if (!playbackStarted) {
         return;
@@ -185,7 +357,6 @@ void AudioDecoder::stopPlayback() {
     // Stop decoding
     shouldStop = true;
     isDecoding = false;
-    queueCondition.notify_all();
 
     // Wait for decoder thread to finish
     if (decoderThread.joinable()) {
@@ -196,55 +367,50 @@ void AudioDecoder::stopPlayback() {
     if (audioDevice != 0) {
         SDL_CloseAudioDevice(audioDevice);
         audioDevice = 0;
+        deviceBufferFrames = 0;
     }
 
-    // Clear buffers
-    clearQueue();
-    audioBuffer.clear();
-    bufferPosition = 0;
+    // Neither side of the ring runs any more
+    sampleRing.clear();
 
     playbackStarted = false;
     playbackPaused = false;
-    currentTime = 0.0;
+    clock.set(0.0);
 
-    std::cout << "Audio playback stopped" << std::endl;
+    AudioCallbackStats stats = getCallbackStats();
+    std::cout << "Audio playback stopped (" << stats.callbacks << " callbacks, worst "
+        << stats.worstMs << "ms, avg " << stats.averageMs << "ms, "
+        << stats.shortCallbacks << " short)" << std::endl;
 }
 
 void AudioDecoder::pausePlayback() {
     if (playbackStarted && !playbackPaused) {
         playbackPaused = true;
         SDL_PauseAudioDevice(audioDevice, 1);
-        std::cout << "Audio playback paused" << std::endl;
+
+        // The callback has stopped, hold the clock where it is
+        clock.pause();
+        LOG_INFO("Audio playback paused");
     }
 }
 
 void AudioDecoder::resumePlayback() {
     if (playbackStarted && playbackPaused) {
         playbackPaused = false;
+        clock.resume();
         SDL_PauseAudioDevice(audioDevice, 0);
-        std::cout << "Audio playback resumed" << std::endl;
+        LOG_INFO("Audio playback resumed");
     }
 }
 
 void AudioDecoder::decodingLoop() {
     std::cout << "Audio decoding thread started" << std::endl;
+    TRACE_THREAD_NAME("audio decode");
 
+    // Decoding is paced by the sample ring filling up
     while (isDecoding && !shouldStop) {
-        // Check if we need to decode more frames
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            if (audioFrameQueue.size() > 10) { // Keep buffer from getting too large
-                queueCondition.wait(lock, [this] {
-                    return audioFrameQueue.size() <= 5 || shouldStop;
-                    });
-            }
-        }
-
-        if (shouldStop) break;
-
         if (!decodeNextFrame()) {
-            // End of file or error
-            std::cout << "Audio decoding finished" << std::endl;
+            // Packet queue was aborted
             break;
         }
     }
@@ -253,57 +419,98 @@ void AudioDecoder::decodingLoop() {
 }
 
 bool AudioDecoder::decodeNextFrame() {
-    AVPacket packet;
-    av_init_packet(&packet);
-
-    // Read packet from file
-    if (av_read_frame(formatContext, &packet) < 0) {
-        return false; // End of file
+    // Take the next packet from the demuxer
+    int serial = 0;
+    int ret = packetQueue->get(packet, &serial, PACKET_WAIT_MS);
+    if (ret < 0) {
+        return false; // Queue aborted
+    }
+    if (ret == 0) {
+        return true; // Nothing queued yet
     }
 
-    // Skip non-audio packets
-    if (packet.stream_index != audioStreamIndex) {
-        av_packet_unref(&packet);
-        return true;
+    // Packets after a seek start a new serial, drop the old codec state
+    if (serial != packetSerial) {
+        avcodec_flush_buffers(codecContext);
+        packetSerial = serial;
     }
 
+    TRACE_SCOPE("audio decode");
+
+    // An empty packet marks the end of the stream, drain the decoder
+    bool drain = !packet->data && packet->size == 0;
+
     // Send packet to decoder
-    if (avcodec_send_packet(codecContext, &packet) < 0) {
-        av_packet_unref(&packet);
-        return false;
+    if (avcodec_send_packet(codecContext, drain ? nullptr : packet) < 0) {
+        av_packet_unref(packet);
+        return true;
     }
 
     // Receive decoded frames
-    AVFrame* frame = av_frame_alloc();
-    while (avcodec_receive_frame(codecContext, frame) == 0) {
-        // Convert and add to queue
-        AudioFrame audioFrame;
-        if (convertAudioFrame(frame, audioFrame)) {
-            std::lock_guard<std::mutex> lock(queueMutex);
-            audioFrameQueue.push(audioFrame);
-            queueCondition.notify_one();
+    while (avcodec_receive_frame(codecContext, decodedFrame) == 0) {
+        // Convert and hand over to the audio callback
+        size_t frames = 0;
+        double pts = 0.0;
+        if (convertAudioFrame(decodedFrame, frames, pts)) {
+            writeSamples(frames, pts, serial);
         }
 
-        av_frame_unref(frame);
+        av_frame_unref(decodedFrame);
     }
 
-    av_frame_free(&frame);
-    av_packet_unref(&packet);
+    av_packet_unref(packet);
+
+    if (drain) {
+        endOfStream = true;
+        LOG_INFO("Audio decoding finished");
+    }
     return true;
 }
 
-bool AudioDecoder::convertAudioFrame(AVFrame* frame, AudioFrame& audioFrame) {
-    // Calculate output sample count
+bool AudioDecoder::writeSamples(size_t frames, double pts, int serial) {
+    // Wait for the callback to make room; samples from before a seek
+    // would only be dropped by it, so they are given up on instead
+    size_t written = 0;
+    while (written < frames && !shouldStop && serial == playbackSerial) {
+        size_t count = sampleRing.write(convertBuffer.data() + written * OUTPUT_CHANNELS,
+            frames - written, pts + (double)written / sampleRate, serial);
+        written += count;
+        if (count == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(RING_FULL_WAIT_MS));
+        }
+    }
+    return written == frames;
+}
+
+bool AudioDecoder::convertAudioFrame(AVFrame* frame, size_t& frames, double& pts) {
+    // Stretch or squeeze slightly when audio has to follow another clock
+    double drift = syncDrift;
+    if (std::fabs(drift) > AUDIO_DRIFT_THRESHOLD && std::fabs(drift) < AUDIO_NOSYNC_THRESHOLD) {
+        int samples = frame->nb_samples;
+        int wanted = samples - (int)(drift * frame->sample_rate);
+        wanted = std::max(samples * (100 - MAX_CORRECTION_PERCENT) / 100,
+            std::min(samples * (100 + MAX_CORRECTION_PERCENT) / 100, wanted));
+        if (wanted != samples) {
+            swr_set_compensation(swrContext,
+                (int)((int64_t)(wanted - samples) * sampleRate / frame->sample_rate),
+                (int)((int64_t)wanted * sampleRate / frame->sample_rate));
+        }
+    }
+
+    // Calculate output sample count, with room for the stretch
     int outputSamples = swr_get_out_samples(swrContext, frame->nb_samples);
     if (outputSamples <= 0) {
         return false;
     }
+    outputSamples += outputSamples * MAX_CORRECTION_PERCENT / 100 + 1;
 
-    // Allocate output buffer
-    int outputBufferSize = av_samples_get_buffer_size(nullptr, 2, outputSamples, AV_SAMPLE_FMT_S16, 0);
-    audioFrame.data.resize(outputBufferSize);
+    // The conversion buffer only ever grows
+    size_t outputSize = (size_t)outputSamples * OUTPUT_CHANNELS;
+    if (convertBuffer.size() < outputSize) {
+        convertBuffer.resize(outputSize);
+    }
 
-    uint8_t* outputBuffer = audioFrame.data.data();
+    uint8_t* outputBuffer = reinterpret_cast<uint8_t*>(convertBuffer.data());
 
     // Convert audio
     int convertedSamples = swr_convert(
@@ -318,108 +525,142 @@ bool AudioDecoder::convertAudioFrame(AVFrame* frame, AudioFrame& audioFrame) {
         return false;
     }
 
-    // Resize buffer to actual converted size
-    int actualSize = av_samples_get_buffer_size(nullptr, 2, convertedSamples, AV_SAMPLE_FMT_S16, 0);
-    audioFrame.data.resize(actualSize);
-
-    // Set timestamp
-    audioFrame.pts = frame->pts;
-    audioFrame.timestamp = frame->pts * av_q2d(audioStream->time_base);
-
+    frames = (size_t)convertedSamples;
+    pts = frame->pts * av_q2d(audioStream->time_base);
     return true;
 }
 
 void AudioDecoder::audioCallback(void* userdata, uint8_t* stream, int len) {
     AudioDecoder* decoder = static_cast<AudioDecoder*>(userdata);
+    TRACE_THREAD_NAME("audio callback");
     decoder->fillAudioBuffer(stream, len);
 }
 
-void AudioDecoder::fillAudioBuffer(uint8_t* stream, int len) {
-    std::lock_guard<std::mutex> lock(bufferMutex);
+size_t AudioDecoder::fillAudioBuffer(uint8_t* stream, int len) {
+    // Runs on the audio thread: no locks, no allocations
+    TRACE_SCOPE("audio callback");
+    Uint64 started = SDL_GetPerformanceCounter();
 
     // Clear the stream first
     memset(stream, 0, len);
 
-    if (playbackPaused) {
-        return;
-    }
-
-    int bytesNeeded = len;
-    int streamPos = 0;
+    size_t framesCopied = 0;
+    if (!playbackPaused) {
+        int16_t* output = reinterpret_cast<int16_t*>(stream);
+        size_t framesNeeded = (size_t)len / BYTES_PER_SAMPLE;
+        int serial = playbackSerial;
+        double target = seekTarget;
+        double firstPts = 0.0;
+        double lastPts = 0.0;
+
+        SampleSegment segment;
+        while (framesNeeded > 0 && sampleRing.peekSegment(segment)) {
+            // Skip samples decoded from packets queued before a seek
+            if (segment.serial != serial) {
+                sampleRing.skip(segment.frames);
+                continue;
+            }
 
-    while (bytesNeeded > 0) {
-        // If current buffer is empty, get next frame
-        if (bufferPosition >= audioBuffer.size()) {
-            std::unique_lock<std::mutex> queueLock(queueMutex);
-            if (audioFrameQueue.empty()) {
-                break; // No more audio data
+            // After a seek the decoders start at the keyframe before the
+            // target, so audio up to the target is skipped
+            if (segment.pts < target) {
+                size_t early = (size_t)((target - segment.pts) * sampleRate);
+                if (early > 0) {
+                    sampleRing.skip(std::min(early, segment.frames));
+                    continue;
+                }
             }
 
-            AudioFrame frame = audioFrameQueue.front();
-            audioFrameQueue.pop();
-            queueLock.unlock();
+            size_t count = sampleRing.read(output, std::min(framesNeeded, segment.frames));
+            if (framesCopied == 0) {
+                firstPts = segment.pts;
+            }
+            lastPts = segment.pts + (double)count / sampleRate;
+            output += count * OUTPUT_CHANNELS;
+            framesNeeded -= count;
+            framesCopied += count;
+        }
 
-            audioBuffer = std::move(frame.data);
-            bufferPosition = 0;
-            currentTime = frame.timestamp;
+        // The first copied sample plays once the device has finished the
+        // buffer it is playing now, so that much is subtracted; without
+        // new samples the clock runs on until the last one queued
+        if (framesCopied > 0) {
+            double deviceDelay = (double)audioSpec.samples / sampleRate;
+            int64_t now = av_gettime_relative();
+            clock.update(firstPts - deviceDelay, lastPts, now, true);
 
-            queueCondition.notify_one();
+            if (firstSampleTime < 0) {
+                firstSampleTime = now + (int64_t)(deviceDelay * 1000000.0);
+            }
         }
 
-        // Copy from current buffer
-        int availableBytes = audioBuffer.size() - bufferPosition;
-        int bytesToCopy = std::min(bytesNeeded, availableBytes);
+        if (framesNeeded > 0) {
+            shortCallbackCount++;
 
-        memcpy(stream + streamPos, audioBuffer.data() + bufferPosition, bytesToCopy);
-
-        bufferPosition += bytesToCopy;
-        streamPos += bytesToCopy;
-        bytesNeeded -= bytesToCopy;
+            // Running dry mid-stream is an underrun; the start, seeks and
+            // the end of the stream are not, nor are pulls without a device
+            if (underrunArmed && audioDevice != 0 && !endOfStream) {
+                underrunCount++;
+            }
+            underrunArmed = false;
+        }
+        else {
+            underrunArmed = true;
+        }
     }
-}
 
-void AudioDecoder::clearQueue() {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    while (!audioFrameQueue.empty()) {
-        audioFrameQueue.pop();
+    uint64_t ticks = SDL_GetPerformanceCounter() - started;
+    callbackCount++;
+    callbackTicks += ticks;
+    if (ticks > worstCallbackTicks) {
+        worstCallbackTicks = ticks;
     }
+    return framesCopied;
 }
 
 bool AudioDecoder::seekToTime(double seconds) {
-    if (!formatContext) {
+    if (!codecContext) {
         return false;
     }
 
-    int64_t timestamp = seconds * AV_TIME_BASE;
+    // The demuxer has already repositioned the file and flushed the packet
+    // queue; the decoding thread flushes the codec when it sees the new
+    // serial, and the audio callback drops what was decoded before
+    seekTarget = seconds;
+    playbackSerial = packetQueue->getSerial();
+    endOfStream = false;
+    underrunArmed = false;
 
-    // Stop current playback temporarily
-    bool wasPlaying = isPlaying();
-    if (wasPlaying) {
-        pausePlayback();
+    // Hold the clock at the target until the callback plays from there
+    if (audioDevice != 0) {
+        SDL_LockAudioDevice(audioDevice);
     }
-
-    // Seek in file
-    if (av_seek_frame(formatContext, -1, timestamp, AVSEEK_FLAG_BACKWARD) < 0) {
-        std::cerr << "Failed to seek to time: " << seconds << std::endl;
-        return false;
+    clock.set(seconds);
+    if (audioDevice != 0) {
+        SDL_UnlockAudioDevice(audioDevice);
     }
 
-    // Flush decoder
-    avcodec_flush_buffers(codecContext);
+    LOG_INFO("Seeked to time: %gs", seconds);
+    return true;
+}
 
-    // Clear buffers
-    clearQueue();
-    audioBuffer.clear();
-    bufferPosition = 0;
-    currentTime = seconds;
+double AudioDecoder::getRingFill() const {
+    size_t capacity = sampleRing.getCapacity();
+    return capacity > 0 ? (double)sampleRing.getReadableFrames() / capacity : 0.0;
+}
 
-    // Resume playback if it was playing
-    if (wasPlaying) {
-        resumePlayback();
-    }
+double AudioDecoder::getThreadCpuTime() {
+    return ::getThreadCpuTime(decoderThread);
+}
 
-    std::cout << "Seeked to time: " << seconds << "s" << std::endl;
-    return true;
+AudioCallbackStats AudioDecoder::getCallbackStats() const {
+    AudioCallbackStats stats;
+    double tickMs = 1000.0 / SDL_GetPerformanceFrequency();
+    stats.callbacks = callbackCount;
+    stats.shortCallbacks = shortCallbackCount;
+    stats.worstMs = worstCallbackTicks * tickMs;
+    stats.averageMs = stats.callbacks > 0 ? callbackTicks * tickMs / stats.callbacks : 0.0;
+    return stats;
 }
 
 void AudioDecoder::close() {
@@ -433,20 +674,33 @@ void AudioDecoder::close() {
         avcodec_free_context(&codecContext);
     }
 
-    if (formatContext) {
-        avformat_close_input(&formatContext);
+    if (packet) {
+        av_packet_free(&packet);
+    }
+
+    if (decodedFrame) {
+        av_frame_free(&decodedFrame);
     }
 
-    audioStreamIndex = -1;
+    // Stop receiving packets
+    if (demuxer && packetQueue) {
+        demuxer->detachStream(AVMEDIA_TYPE_AUDIO);
+    }
+    packetQueue = nullptr;
+    audioStream = nullptr;
+    demuxer = nullptr;
+
+    packetSerial = -1;
     sampleRate = 0;
     channels = 0;
     duration = 0;
-    currentTime = 0.0;
+    clock.set(0.0);
+    seekTarget = -DBL_MAX;
 }
 
 // Getter methods
 bool AudioDecoder::isFileOpen() const {
-    return formatContext != nullptr;
+    return codecContext != nullptr;
 }
 
 int AudioDecoder::getSampleRate() const {
@@ -457,14 +711,26 @@ int AudioDecoder::getChannels() const {
     return channels;
 }
 
+int AudioDecoder::getOutputChannels() const {
+    return OUTPUT_CHANNELS;
+}
+
 int64_t AudioDecoder::getDuration() const {
     return duration;
 }
 
 double AudioDecoder::getCurrentTime() const {
-    return currentTime.load();
+    return clock.get();
 }
 
 bool AudioDecoder::isPlaying() const {
     return playbackStarted && !playbackPaused;
+}
+
+size_t AudioDecoder::readSamples(uint8_t* stream, int len) {
+    return fillAudioBuffer(stream, len);
+}
+
+bool AudioDecoder::hasEnded() const {
+    return endOfStream && sampleRing.getReadableFrames() == 0;
 }
\ No newline at end of file
@@ -5,25 +5,48 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <queue>
 #include <mutex>
 #include <thread>
 #include <atomic>
-#include <condition_variable>
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
 #include <libswresample/swresample.h>
+#include <libavutil/time.h>
 }
 
 #include <SDL.h>
 
-struct AudioFrame {
-    std::vector<uint8_t> data;
-    int64_t pts;
-    double timestamp;
+#include "Demuxer.h"
+#include "SampleRing.h"
+#include "AudioClock.h"
+
+// Size of the audio device buffer. Smaller buffers let pause, seek and
+// volume changes be heard sooner and keep the audio clock finer, but give
+// the callback less slack before it runs dry.
+enum class AudioLatency {
+    Lowest,     // 256 sample frames
+    Low,        // 512
+    Medium,     // 1024
+    High,       // 4096
+    Adaptive    // Starts at 512 and doubles after underruns, up to 4096
+};
+
+struct AudioLatencyStats {
+    int bufferFrames;       // Device buffer in sample frames, 0 without a device
+    double latencyMs;       // How long that buffer plays at the output rate
+    uint64_t underruns;     // Times the callback ran dry in the middle of playback
+    int resizes;            // Times the adaptive buffer grew
+};
+
+// Timing of the SDL audio callback
+struct AudioCallbackStats {
+    uint64_t callbacks;
+    uint64_t shortCallbacks;    // Callbacks that ran out of samples
+    double worstMs;
+    double averageMs;
 };
 
 class AudioDecoder {
@@ -31,76 +54,142 @@ public:
     AudioDecoder();
     ~AudioDecoder();
 
-    bool openFile(const std::string& filename);
+    bool openStream(Demuxer& demuxer);
     void close();
     bool isFileOpen() const;
 
     // Audio properties
     int getSampleRate() const;
     int getChannels() const;
+    int getOutputChannels() const;
     int64_t getDuration() const;
     double getCurrentTime() const;
 
-    // Playback control
-    bool startPlayback();
+    // Playback control. Without a device nothing paces the decoder; the
+    // caller pulls samples with readSamples as fast as it wants them.
+    bool startPlayback(bool openDevice = true);
     void stopPlayback();
     void pausePlayback();
     void resumePlayback();
     bool isPlaying() const;
+    // Started and then paused; resumePlayback continues it
+    bool isPaused() const { return playbackStarted && playbackPaused; }
+    // Fills stream like the device callback; returns the sample frames
+    // taken from the ring, the rest is silence
+    size_t readSamples(uint8_t* stream, int len);
+
+    // The stream was decoded to its end and every sample was played
+    bool hasEnded() const;
 
     // Seeking
     bool seekToTime(double seconds);
 
+    AudioCallbackStats getCallbackStats() const;
+
+    // CPU seconds used by the decoding thread while it runs
+    double getThreadCpuTime();
+
+    // Share of the sample ring holding decoded audio, 0 to 1
+    double getRingFill() const;
+
+    // How far audio runs ahead of the master clock when it is not the
+    // master itself; the resampler stretches or squeezes audio to close it
+    void setSyncDrift(double seconds) { syncDrift = seconds; }
+
+    // Bit-exact decoding, applied on the next openStream
+    void setBitexact(bool enabled) { bitexact = enabled; }
+
+    // Device buffer size, applied on the next startPlayback
+    void setLatency(AudioLatency profile) { latency = profile; }
+    AudioLatency getLatency() const { return latency; }
+    AudioLatencyStats getLatencyStats() const;
+
+    // Grows the adaptive buffer after underruns by reopening the device;
+    // call from the thread that starts and pauses playback. True if the
+    // buffer was grown.
+    bool adaptLatency();
+
+    static const char* getLatencyName(AudioLatency profile);
+    // "256", "512", "1024", "4096" or "adaptive"
+    static bool parseLatency(const std::string& name, AudioLatency& profile);
+
+    // When the first sample since opening was heard, av_gettime_relative()
+    // microseconds, or -1
+    int64_t getFirstSampleTime() const { return firstSampleTime; }
+
     // Audio callback for SDL
     static void audioCallback(void* userdata, uint8_t* stream, int len);
 
 private:
-    // FFmpeg components
-    AVFormatContext* formatContext;
+    // FFmpeg components (the format context belongs to the demuxer)
+    Demuxer* demuxer;
+    PacketQueue* packetQueue;
     AVCodecContext* codecContext;
     AVStream* audioStream;
     SwrContext* swrContext;
+    AVPacket* packet;
+    AVFrame* decodedFrame;  // Reused for every frame the codec returns
 
     // Audio properties
     int sampleRate;
     int channels;
     int64_t duration;
-    int audioStreamIndex;
+    int packetSerial;
+    bool bitexact;
 
     // SDL Audio
     SDL_AudioDeviceID audioDevice;
     SDL_AudioSpec audioSpec;
 
+    // Device buffer size; an underrun is only counted once a callback has
+    // been filled since the start, the last seek or a device reopen. The
+    // device may be opened on another thread (fast start), so what the
+    // stats report is published through atomics rather than audioSpec.
+    AudioLatency latency;
+    std::atomic<int> deviceBufferFrames;
+    std::atomic<uint64_t> underrunCount;
+    std::atomic<bool> underrunArmed;
+    uint64_t adaptedUnderruns;
+    int64_t lastResizeTime;
+    std::atomic<int> latencyResizes;
+
     // Threading and synchronization
     std::thread decoderThread;
     std::atomic<bool> isDecoding;
     std::atomic<bool> playbackStarted;
     std::atomic<bool> playbackPaused;
     std::atomic<bool> shouldStop;
-
-    // Audio buffer
-    std::queue<AudioFrame> audioFrameQueue;
-    std::mutex queueMutex;
-    std::condition_variable queueCondition;
-
-    // Current playback position
-    std::atomic<double> currentTime;
-
-    // Buffer for audio callback
-    std::vector<uint8_t> audioBuffer;
-    size_t bufferPosition;
-    std::mutex bufferMutex;
+    std::atomic<bool> endOfStream;
+
+    // Time of the sample being heard, readable from any thread
+    AudioClock clock;
+
+    // Decoded samples on their way to the audio callback, which drops
+    // samples from before the latest seek or before its target
+    SampleRing sampleRing;
+    std::vector<int16_t> convertBuffer;
+    std::atomic<int> playbackSerial;
+    std::atomic<double> seekTarget;
+    std::atomic<double> syncDrift;
+    std::atomic<int64_t> firstSampleTime;
+
+    // Audio callback timing
+    std::atomic<uint64_t> callbackCount;
+    std::atomic<uint64_t> shortCallbackCount;
+    std::atomic<uint64_t> callbackTicks;
+    std::atomic<uint64_t> worstCallbackTicks;
 
     // Private methods
     bool initializeDecoder();
     void decodingLoop();
     bool decodeNextFrame();
-    void fillAudioBuffer(uint8_t* stream, int len);
-    void clearQueue();
+    bool writeSamples(size_t frames, double pts, int serial);
+    size_t fillAudioBuffer(uint8_t* stream, int len);
+    bool openAudioDevice(int bufferFrames);
 
     // Audio format conversion
     bool setupResampler();
-    bool convertAudioFrame(AVFrame* frame, AudioFrame& audioFrame);
+    bool convertAudioFrame(AVFrame* frame, size_t& frames, double& pts);
 };
 
 #endif // AUDIODECODER_H
\ No newline at end of file
@@ -0,0 +1,502 @@
+// Benchmarks.cpp
+#include "Benchmarks.h"
+#include "SampleRing.h"
+#include "SyncEngine.h"
+#include "Demuxer.h"
+#include "ColorConverter.h"
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <cstdio>
+
+extern "C" {
+#include <libswscale/swscale.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+const int STRESS_SAMPLE_RATE = 48000;
+const int STRESS_CHANNELS = 2;
+const int STRESS_RING_MS = 500;
+
+// A 512-frame device buffer at 48 kHz, about 10.7 ms per callback
+const size_t CALLBACK_FRAMES = 512;
+
+// The producer starts a new serial this often, like a seek
+const int FRAMES_PER_SERIAL = STRESS_SAMPLE_RATE * 2;
+
+// Synthetic streams for the sync simulation
+const double SIM_FRAME_DURATION = 0.04;
+const double SIM_SECONDS = 20.0;
+const double SIM_MAX_FINAL_DRIFT = 0.08;
+
+// Stands in for the resampler: audio following another clock is pulled in
+// by at most this share of real time
+const double SIM_AUDIO_CORRECTION = 0.1;
+const double SIM_AUDIO_DRIFT_THRESHOLD = 0.03;
+
+typedef std::chrono::steady_clock Clock;
+
+// Conversions timed per kernel and picture
+const int CONVERSION_ITERATIONS = 3;
+
+// The kernels share their coefficients, so agreeing with each other says
+// nothing about the matrix or range; swscale is the outside reference.
+// Rounding and chroma siting differences stay well above this.
+const double MIN_SWSCALE_PSNR = 40.0;
+
+// Planes of a synthetic picture, rows padded like FFmpeg's
+const int PLANE_ALIGN = 64;
+
+// Four plane slots, as swscale reads them
+struct TestPicture {
+    std::vector<uint8_t> planes[4];
+    const uint8_t* data[4];
+    int stride[4];
+};
+
+int alignedStride(int bytes) {
+    return (bytes + PLANE_ALIGN - 1) / PLANE_ALIGN * PLANE_ALIGN;
+}
+
+// Gradients over the full 0-255 code range, so limited range input also
+// exercises clamping. Luma carries noise; chroma stays smooth so swscale's
+// interpolated chroma upsampling stays comparable with the kernels'.
+TestPicture makeTestPicture(AVPixelFormat format, int width, int height) {
+    std::mt19937 random(12345);
+    std::uniform_int_distribution<int> noise(-24, 24);
+    auto sample = [&](int base) { return (uint8_t)std::min(255, std::max(0, base + noise(random))); };
+
+    bool semiPlanar = format == AV_PIX_FMT_NV12 || format == AV_PIX_FMT_NV21;
+    bool subsampled = format != AV_PIX_FMT_YUV422P && format != AV_PIX_FMT_YUVJ422P;
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = subsampled ? (height + 1) / 2 : height;
+
+    TestPicture picture;
+    picture.stride[0] = alignedStride(width);
+    picture.planes[0].resize((size_t)picture.stride[0] * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            picture.planes[0][(size_t)y * picture.stride[0] + x] = sample(x * 255 / width);
+        }
+    }
+
+    int chromaPlanes = semiPlanar ? 1 : 2;
+    for (int p = 1; p <= chromaPlanes; p++) {
+        int samplesPerRow = semiPlanar ? chromaWidth * 2 : chromaWidth;
+        picture.stride[p] = alignedStride(samplesPerRow);
+        picture.planes[p].resize((size_t)picture.stride[p] * chromaHeight);
+        for (int y = 0; y < chromaHeight; y++) {
+            for (int i = 0; i < samplesPerRow; i++) {
+                // U runs down the picture, V across it
+                bool isU = semiPlanar ? (i % 2 == 0) : p == 1;
+                int x = semiPlanar ? i / 2 : i;
+                int base = isU ? y * 255 / chromaHeight : 255 - x * 255 / chromaWidth;
+                picture.planes[p][(size_t)y * picture.stride[p] + i] = (uint8_t)base;
+            }
+        }
+    }
+    for (int p = 0; p < 4; p++) {
+        picture.data[p] = picture.planes[p].empty() ? nullptr : picture.planes[p].data();
+        if (picture.planes[p].empty()) {
+            picture.stride[p] = 0;
+        }
+    }
+    return picture;
+}
+
+// PSNR over the colour bytes of two packed pictures, alpha left out
+double measurePsnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int width, int height,
+    int pixelSize, int stride) {
+    double squaredError = 0.0;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* rowA = a.data() + (size_t)y * stride;
+        const uint8_t* rowB = b.data() + (size_t)y * stride;
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                int difference = rowA[x * pixelSize + c] - rowB[x * pixelSize + c];
+                squaredError += difference * difference;
+            }
+        }
+    }
+    double mse = squaredError / ((double)width * height * 3);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+// Converts one format, matrix and range with every kernel and swscale;
+// false if a kernel's output differs from the scalar kernel's
+bool checkConversion(const TestPicture& picture, AVPixelFormat source, AVPixelFormat destination,
+    int width, int height, YuvMatrix matrix, YuvRange range) {
+    const ConversionKernel kernels[] = { ConversionKernel::Scalar, ConversionKernel::Sse2, ConversionKernel::Avx2 };
+    int pixelSize = destination == AV_PIX_FMT_RGB24 ? 3 : 4;
+    int stride = alignedStride(width * pixelSize);
+    bool fullRange = range == YuvRange::Full || source == AV_PIX_FMT_YUVJ420P || source == AV_PIX_FMT_YUVJ422P;
+
+    char label[96];
+    snprintf(label, sizeof(label), "%dx%d %s->%s %s %s", width, height,
+        av_get_pix_fmt_name(source), av_get_pix_fmt_name(destination),
+        matrix == YuvMatrix::BT709 ? "bt709" : "bt601", fullRange ? "full" : "limited");
+    std::cout << "  " << label << ":";
+
+    bool passed = true;
+    std::vector<uint8_t> reference;
+    std::vector<uint8_t> output((size_t)stride * height);
+    for (ConversionKernel kernel : kernels) {
+        ColorConverter converter;
+        if (!converter.configure(source, destination, width, matrix, range, kernel)) {
+            continue;
+        }
+
+        Clock::time_point started = Clock::now();
+        for (int i = 0; i < CONVERSION_ITERATIONS; i++) {
+            converter.convert(picture.data, picture.stride, output.data(), stride, height);
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - started).count() / CONVERSION_ITERATIONS;
+        std::cout << " " << converter.getKernelName() << " " << ms << " ms";
+
+        if (reference.empty()) {
+            reference = output;
+            continue;
+        }
+        for (int y = 0; y < height && passed; y++) {
+            for (int x = 0; x < width * pixelSize; x++) {
+                size_t offset = (size_t)y * stride + x;
+                if (output[offset] != reference[offset]) {
+                    std::cout << std::endl << "  MISMATCH: " << converter.getKernelName() << " differs from scalar at x "
+                        << x / pixelSize << " y " << y << " (" << (int)output[offset] << " vs "
+                        << (int)reference[offset] << ")";
+                    passed = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    SwsContext* scaler = sws_getContext(width, height, source, width, height, destination,
+        SWS_BILINEAR | SWS_ACCURATE_RND, nullptr, nullptr, nullptr);
+    if (scaler) {
+        sws_setColorspaceDetails(scaler,
+            sws_getCoefficients(matrix == YuvMatrix::BT709 ? SWS_CS_ITU709 : SWS_CS_ITU601), fullRange ? 1 : 0,
+            sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16);
+
+        uint8_t* destinationData[4] = { output.data(), nullptr, nullptr, nullptr };
+        int destinationStride[4] = { stride, 0, 0, 0 };
+        Clock::time_point started = Clock::now();
+        for (int i = 0; i < CONVERSION_ITERATIONS; i++) {
+            sws_scale(scaler, picture.data, picture.stride, 0, height, destinationData, destinationStride);
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - started).count() / CONVERSION_ITERATIONS;
+        sws_freeContext(scaler);
+
+        double psnr = measurePsnr(reference, output, width, height, pixelSize, stride);
+        std::cout << " swscale " << ms << " ms, PSNR " << psnr << " dB";
+        if (psnr < MIN_SWSCALE_PSNR) {
+            std::cout << std::endl << "  MISMATCH: PSNR against swscale below " << MIN_SWSCALE_PSNR << " dB";
+            passed = false;
+        }
+    }
+    std::cout << std::endl;
+    return passed;
+}
+
+// How often the decode benchmark looks for new pictures when none are ready
+const int DECODE_POLL_US = 200;
+
+// Pictures decoded per second in one pass of at most seconds, or a negative
+// value if the file has no video that can be decoded
+double measureDecodeRate(const std::string& filename, ThreadingPolicy policy, int threads, double seconds) {
+    Demuxer demuxer;
+    if (!demuxer.openFile(filename)) {
+        return -1.0;
+    }
+    VideoDecoder decoder;
+    decoder.setThreadingPolicy(policy, threads);
+    if (!decoder.OpenStream(demuxer)) {
+        return -1.0;
+    }
+    demuxer.start();
+
+    // Pictures are taken off the queue as soon as they arrive, so the
+    // decoder never waits on a full queue
+    Clock::time_point started = Clock::now();
+    Clock::time_point deadline = started + std::chrono::microseconds((int64_t)(seconds * 1000000.0));
+    while (Clock::now() < deadline && !decoder.hasEnded()) {
+        if (decoder.peekPicture()) {
+            decoder.popPicture();
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::microseconds(DECODE_POLL_US));
+        }
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+    uint64_t frames = decoder.getDecodeStats().framesDecoded;
+
+    decoder.close();
+    demuxer.close();
+    return elapsed > 0.0 ? frames / elapsed : 0.0;
+}
+
+// One run: audio plays offset seconds ahead of the video timestamps
+bool simulateSync(SyncMaster master, double offset) {
+    SyncEngine engine;
+    engine.setMaster(master);
+    engine.setStreams(true, true);
+    engine.reset(0.0, 0.0);
+    engine.setPaused(false, 0.0);
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> tick(0.001, 0.017);
+
+    std::deque<double> pictures;
+    double nextPicturePts = 0.0;
+    double audioOffset = offset;
+    double now = 0.0;
+
+    while (now < SIM_SECONDS) {
+        double step = tick(random);
+        now += step;
+
+        // Audio corrected towards the master unless it is the master
+        double audioDrift = engine.getAudioDrift(now);
+        if (std::fabs(audioDrift) > SIM_AUDIO_DRIFT_THRESHOLD) {
+            double correction = std::min(std::fabs(audioDrift), SIM_AUDIO_CORRECTION * step);
+            audioOffset -= audioDrift > 0.0 ? correction : -correction;
+        }
+        engine.updateAudioClock(now + audioOffset, now);
+
+        // Keep a few decoded pictures queued like the picture queue
+        while (pictures.size() < 4) {
+            pictures.push_back(nextPicturePts);
+            nextPicturePts += SIM_FRAME_DURATION;
+        }
+
+        for (;;) {
+            double nextPts = pictures.size() > 1 ? pictures[1] : -1.0;
+            FrameAction action = engine.decide(pictures.front(), SIM_FRAME_DURATION, nextPts, now);
+            if (action == FrameAction::Wait) {
+                break;
+            }
+            pictures.pop_front();
+            if (action == FrameAction::Show) {
+                break;
+            }
+        }
+    }
+
+    const SyncStats& stats = engine.getStats();
+    double finalDrift = engine.getVideoClock(now) - engine.getMasterClock(now);
+    double finalAudioDrift = engine.getAudioDrift(now);
+    bool converged = std::fabs(finalDrift) < SIM_MAX_FINAL_DRIFT &&
+        std::fabs(finalAudioDrift) < SIM_MAX_FINAL_DRIFT;
+
+    std::cout << SyncEngine::getMasterName(master) << " master, offset " << offset
+        << "s: shown " << stats.framesShown << ", dropped " << stats.framesDropped
+        << ", repeated " << stats.framesRepeated << ", corrections " << stats.corrections
+        << ", max drift " << stats.maxDrift << "s, final drift " << finalDrift
+        << "s video / " << finalAudioDrift << "s audio"
+        << (converged ? "" : "  FAILED") << std::endl;
+    return converged;
+}
+}
+
+bool runSampleRingStress(double seconds) {
+    SampleRing ring;
+    if (!ring.init(STRESS_SAMPLE_RATE, STRESS_CHANNELS, STRESS_RING_MS)) {
+        return false;
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> latestSerial(0);
+
+    // Producer: random chunk sizes, sample values count up per serial so
+    // the consumer can check continuity
+    std::thread producer([&] {
+        std::mt19937 random(12345);
+        std::uniform_int_distribution<int> chunkSize(64, 4096);
+        std::vector<int16_t> chunk(4096 * STRESS_CHANNELS);
+        int serial = 0;
+        int64_t frame = 0;
+
+        while (!stop) {
+            if (frame >= FRAMES_PER_SERIAL) {
+                serial++;
+                frame = 0;
+                latestSerial = serial;
+            }
+
+            size_t frames = (size_t)chunkSize(random);
+            for (size_t i = 0; i < frames; i++) {
+                for (int c = 0; c < STRESS_CHANNELS; c++) {
+                    chunk[i * STRESS_CHANNELS + c] = (int16_t)(frame + i);
+                }
+            }
+
+            size_t written = 0;
+            while (written < frames && !stop) {
+                size_t count = ring.write(chunk.data() + written * STRESS_CHANNELS, frames - written,
+                    (double)(frame + written) / STRESS_SAMPLE_RATE, serial);
+                written += count;
+                if (count == 0) {
+                    std::this_thread::yield();
+                }
+            }
+            frame += frames;
+        }
+    });
+
+    // Consumer: the same peek/skip/read sequence as the audio callback
+    std::vector<int16_t> output(CALLBACK_FRAMES * STRESS_CHANNELS);
+    std::vector<double> callbackTimes;
+    uint64_t shortCallbacks = 0;
+    uint64_t errors = 0;
+    int lastSerial = -1;
+    int16_t expected = 0;
+
+    Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    Clock::time_point nextCallback = Clock::now();
+    while (Clock::now() < end) {
+        std::this_thread::sleep_until(nextCallback);
+        nextCallback += std::chrono::microseconds(CALLBACK_FRAMES * 1000000 / STRESS_SAMPLE_RATE);
+
+        Clock::time_point started = Clock::now();
+        int serial = latestSerial;
+        size_t needed = CALLBACK_FRAMES;
+        int16_t* destination = output.data();
+
+        SampleSegment segment;
+        while (needed > 0 && ring.peekSegment(segment)) {
+            if (segment.serial != serial) {
+                ring.skip(segment.frames);
+                continue;
+            }
+
+            size_t count = ring.read(destination, std::min(needed, segment.frames));
+            if (serial != lastSerial) {
+                lastSerial = serial;
+                expected = destination[0];
+            }
+            for (size_t i = 0; i < count; i++) {
+                if (destination[i * STRESS_CHANNELS] != expected++) {
+                    errors++;
+                    expected = destination[i * STRESS_CHANNELS] + 1;
+                }
+            }
+            destination += count * STRESS_CHANNELS;
+            needed -= count;
+        }
+        if (needed > 0) {
+            shortCallbacks++;
+        }
+
+        callbackTimes.push_back(std::chrono::duration<double, std::micro>(Clock::now() - started).count());
+    }
+
+    stop = true;
+    producer.join();
+
+    if (callbackTimes.empty()) {
+        return false;
+    }
+
+    std::sort(callbackTimes.begin(), callbackTimes.end());
+    double total = 0.0;
+    for (double time : callbackTimes) {
+        total += time;
+    }
+
+    std::cout << "=== Sample Ring Stress ===" << std::endl;
+    std::cout << "Callbacks: " << callbackTimes.size() << " (" << shortCallbacks << " short)" << std::endl;
+    std::cout << "Callback time: avg " << total / callbackTimes.size() << "us, p99 "
+        << callbackTimes[callbackTimes.size() * 99 / 100] << "us, worst "
+        << callbackTimes.back() << "us" << std::endl;
+    std::cout << "Sequence errors: " << errors << std::endl;
+    std::cout << "==========================" << std::endl;
+    return errors == 0;
+}
+
+bool runSyncSimulation() {
+    const SyncMaster masters[] = { SyncMaster::Audio, SyncMaster::Video, SyncMaster::External };
+    const double offsets[] = { -0.5, -0.2, 0.0, 0.2, 0.5 };
+
+    std::cout << "=== A/V Sync Simulation ===" << std::endl;
+    bool passed = true;
+    for (SyncMaster master : masters) {
+        for (double offset : offsets) {
+            passed &= simulateSync(master, offset);
+        }
+    }
+    std::cout << "===========================" << std::endl;
+    return passed;
+}
+
+bool runColorConversionCheck() {
+    const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    const AVPixelFormat sources[] = { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_NV12,
+        AV_PIX_FMT_NV21, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUVJ422P };
+    const AVPixelFormat destinations[] = { AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA, AV_PIX_FMT_BGRA };
+    const YuvMatrix matrices[] = { YuvMatrix::BT601, YuvMatrix::BT709 };
+
+    std::cout << "=== Colour Conversion Check ===" << std::endl;
+    std::cout << "Kernels: scalar" << (ColorConverter::hasKernel(ConversionKernel::Sse2) ? " sse2" : "")
+        << (ColorConverter::hasKernel(ConversionKernel::Avx2) ? " avx2" : "") << std::endl;
+
+    bool passed = true;
+    for (const int* size : sizes) {
+        for (AVPixelFormat source : sources) {
+            TestPicture picture = makeTestPicture(source, size[0], size[1]);
+            // The J formats are always full range
+            bool fixedRange = source == AV_PIX_FMT_YUVJ420P || source == AV_PIX_FMT_YUVJ422P;
+            for (AVPixelFormat destination : destinations) {
+                for (YuvMatrix matrix : matrices) {
+                    passed &= checkConversion(picture, source, destination, size[0], size[1], matrix, YuvRange::Full);
+                    if (!fixedRange) {
+                        passed &= checkConversion(picture, source, destination, size[0], size[1], matrix, YuvRange::Limited);
+                    }
+                }
+            }
+        }
+    }
+    std::cout << (passed ? "All kernels match each other and swscale" : "Conversion mismatches found") << std::endl;
+    std::cout << "===============================" << std::endl;
+    return passed;
+}
+
+bool runDecodeBenchmark(const std::string& filename, ThreadingPolicy policy, double seconds) {
+    // 1, 2, 4, ... threads, and the core count itself if it is not a power of two
+    int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < cores; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(cores);
+
+    std::vector<double> rates;
+    for (int threads : threadCounts) {
+        double rate = measureDecodeRate(filename, policy, threads, seconds);
+        if (rate < 0.0) {
+            std::cerr << "Could not decode video from " << filename << std::endl;
+            return false;
+        }
+        rates.push_back(rate);
+    }
+
+    std::cout << "=== Decode Benchmark ===" << std::endl;
+    std::cout << "File: " << filename << std::endl;
+    std::cout << "Threading: " << VideoDecoder::getThreadingPolicyName(policy) << " policy, "
+        << cores << " cores" << std::endl;
+    for (size_t i = 0; i < threadCounts.size(); i++) {
+        std::cout << "  " << threadCounts[i] << " threads: " << rates[i] << " fps";
+        if (i > 0 && rates[0] > 0.0) {
+            std::cout << " (" << rates[i] / rates[0] << "x)";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "========================" << std::endl;
+    return true;
+}
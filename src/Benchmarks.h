@@ -0,0 +1,29 @@
+// Benchmarks.h
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <string>
+#include "VideoDecoder.h"
+
+// Hammers a SampleRing from a producer thread with random write sizes and
+// simulated seeks while a consumer reads like the audio callback, checks
+// that no sample is lost or reordered, and reports the worst callback time
+bool runSampleRingStress(double seconds);
+
+// Plays synthetic 25 fps video against audio carrying known offsets under
+// each master clock, in simulated time, and checks that presentation
+// converges on the master
+bool runSyncSimulation();
+
+// Converts synthetic 1080p and 4K pictures in every supported format,
+// matrix and range with the scalar, SSE2 and AVX2 kernels and swscale;
+// fails if the kernels disagree on any byte or their PSNR against swscale
+// is too low, and reports the PSNR and the time per frame of each
+bool runColorConversionCheck();
+
+// Decodes the file's video as fast as it goes, with no display or
+// conversion, once per thread count from 1 up to the core count under the
+// given policy, and reports pictures per second for each
+bool runDecodeBenchmark(const std::string& filename, ThreadingPolicy policy, double seconds);
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,371 @@
+// ColorConverter.cpp
+#include "ColorConverter.h"
+#include <cmath>
+
+extern "C" {
+#include <libavutil/cpu.h>
+}
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define COLORCONVERTER_X86 1
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit AVX2 code in functions that ask for it
+#if defined(COLORCONVERTER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define COLORCONVERTER_TARGET_SSE2 __attribute__((target("sse2")))
+#define COLORCONVERTER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define COLORCONVERTER_TARGET_SSE2
+#define COLORCONVERTER_TARGET_AVX2
+#endif
+
+namespace {
+
+// Fixed-point scale of the coefficients
+const double COEFFICIENT_SCALE = 8192.0;
+
+YuvCoefficients makeCoefficients(YuvMatrix matrix, YuvRange range) {
+    double kr = matrix == YuvMatrix::BT709 ? 0.2126 : 0.299;
+    double kb = matrix == YuvMatrix::BT709 ? 0.0722 : 0.114;
+    double kg = 1.0 - kr - kb;
+
+    // Limited range stretches 16..235 luma and 16..240 chroma to full scale
+    bool limited = range == YuvRange::Limited;
+    double yScale = limited ? 255.0 / 219.0 : 1.0;
+    double cScale = limited ? 255.0 / 224.0 : 1.0;
+
+    YuvCoefficients c;
+    c.yOffset = limited ? 16 : 0;
+    c.yScale = (int16_t)std::lround(yScale * COEFFICIENT_SCALE);
+    c.rV = (int16_t)std::lround(2.0 * (1.0 - kr) * cScale * COEFFICIENT_SCALE);
+    c.gU = (int16_t)std::lround(-2.0 * kb * (1.0 - kb) / kg * cScale * COEFFICIENT_SCALE);
+    c.gV = (int16_t)std::lround(-2.0 * kr * (1.0 - kr) / kg * cScale * COEFFICIENT_SCALE);
+    c.bU = (int16_t)std::lround(2.0 * (1.0 - kb) * cScale * COEFFICIENT_SCALE);
+    return c;
+}
+
+// Same arithmetic as _mm_mulhi_epi16, so every kernel gives identical output
+inline int mulHigh(int a, int b) {
+    return (a * b) >> 16;
+}
+
+inline uint8_t toPixel(int value) {
+    value = (value + 4) >> 3;
+    return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// Reference kernel, also finishes the rows the SIMD kernels leave over
+void convertRowScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+    uint8_t* destination, int width, const YuvCoefficients& c, bool rgba) {
+    for (int x = 0; x < width; x++) {
+        int luma = mulHigh((y[x] - c.yOffset) * 64, c.yScale);
+        int cb = (u[x >> 1] - 128) * 64;
+        int cr = (v[x >> 1] - 128) * 64;
+
+        uint8_t r = toPixel(luma + mulHigh(cr, c.rV));
+        uint8_t g = toPixel(luma + mulHigh(cb, c.gU) + mulHigh(cr, c.gV));
+        uint8_t b = toPixel(luma + mulHigh(cb, c.bU));
+
+        uint8_t* pixel = destination + x * 4;
+        pixel[0] = rgba ? r : b;
+        pixel[1] = g;
+        pixel[2] = rgba ? b : r;
+        pixel[3] = 255;
+    }
+}
+
+#ifdef COLORCONVERTER_X86
+
+COLORCONVERTER_TARGET_SSE2
+void convertRowSse2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+    uint8_t* destination, int width, const YuvCoefficients& c, bool rgba) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8((char)0xff);
+    const __m128i round = _mm_set1_epi16(4);
+    const __m128i chromaOffset = _mm_set1_epi16(128);
+    const __m128i yOffset = _mm_set1_epi16(c.yOffset);
+    const __m128i yScale = _mm_set1_epi16(c.yScale);
+    const __m128i rV = _mm_set1_epi16(c.rV);
+    const __m128i gU = _mm_set1_epi16(c.gU);
+    const __m128i gV = _mm_set1_epi16(c.gV);
+    const __m128i bU = _mm_set1_epi16(c.bU);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i y8 = _mm_loadu_si128((const __m128i*)(y + x));
+        __m128i u8 = _mm_loadl_epi64((const __m128i*)(u + x / 2));
+        __m128i v8 = _mm_loadl_epi64((const __m128i*)(v + x / 2));
+
+        // Centre chroma on zero and repeat each sample for two pixels
+        __m128i cb = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(u8, zero), chromaOffset), 6);
+        __m128i cr = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(v8, zero), chromaOffset), 6);
+        __m128i cbLo = _mm_unpacklo_epi16(cb, cb);
+        __m128i cbHi = _mm_unpackhi_epi16(cb, cb);
+        __m128i crLo = _mm_unpacklo_epi16(cr, cr);
+        __m128i crHi = _mm_unpackhi_epi16(cr, cr);
+
+        __m128i lumaLo = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(y8, zero), yOffset), 6), yScale);
+        __m128i lumaHi = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(y8, zero), yOffset), 6), yScale);
+
+        __m128i rLo = _mm_add_epi16(lumaLo, _mm_mulhi_epi16(crLo, rV));
+        __m128i rHi = _mm_add_epi16(lumaHi, _mm_mulhi_epi16(crHi, rV));
+        __m128i gLo = _mm_add_epi16(lumaLo, _mm_add_epi16(_mm_mulhi_epi16(cbLo, gU), _mm_mulhi_epi16(crLo, gV)));
+        __m128i gHi = _mm_add_epi16(lumaHi, _mm_add_epi16(_mm_mulhi_epi16(cbHi, gU), _mm_mulhi_epi16(crHi, gV)));
+        __m128i bLo = _mm_add_epi16(lumaLo, _mm_mulhi_epi16(cbLo, bU));
+        __m128i bHi = _mm_add_epi16(lumaHi, _mm_mulhi_epi16(cbHi, bU));
+
+        // Round, drop the fraction bits and saturate to bytes
+        __m128i r = _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(rLo, round), 3), _mm_srai_epi16(_mm_add_epi16(rHi, round), 3));
+        __m128i g = _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(gLo, round), 3), _mm_srai_epi16(_mm_add_epi16(gHi, round), 3));
+        __m128i b = _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(bLo, round), 3), _mm_srai_epi16(_mm_add_epi16(bHi, round), 3));
+
+        // Interleave into 32-bit pixels
+        __m128i first = rgba ? r : b;
+        __m128i third = rgba ? b : r;
+        __m128i firstGreenLo = _mm_unpacklo_epi8(first, g);
+        __m128i firstGreenHi = _mm_unpackhi_epi8(first, g);
+        __m128i thirdAlphaLo = _mm_unpacklo_epi8(third, alpha);
+        __m128i thirdAlphaHi = _mm_unpackhi_epi8(third, alpha);
+
+        __m128i* out = (__m128i*)(destination + x * 4);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(firstGreenLo, thirdAlphaLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(firstGreenLo, thirdAlphaLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(firstGreenHi, thirdAlphaHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(firstGreenHi, thirdAlphaHi));
+    }
+
+    if (x < width) {
+        convertRowScalar(y + x, u + x / 2, v + x / 2, destination + x * 4, width - x, c, rgba);
+    }
+}
+
+struct Avx2Constants {
+    __m256i round;
+    __m256i chromaOffset;
+    __m256i yOffset;
+    __m256i yScale;
+    __m256i rV;
+    __m256i gU;
+    __m256i gV;
+    __m256i bU;
+};
+
+// Converts 16 pixels to rounded 16-bit R, G and B in pixel order
+COLORCONVERTER_TARGET_AVX2
+inline void convertPixelsAvx2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+    const Avx2Constants& k, __m256i& r, __m256i& g, __m256i& b) {
+    __m128i u8 = _mm_loadl_epi64((const __m128i*)u);
+    __m128i v8 = _mm_loadl_epi64((const __m128i*)v);
+
+    // Repeat each chroma sample for two pixels before widening
+    __m256i cb = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8)), k.chromaOffset), 6);
+    __m256i cr = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8)), k.chromaOffset), 6);
+    __m256i luma = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)y));
+    luma = _mm256_mulhi_epi16(_mm256_slli_epi16(_mm256_sub_epi16(luma, k.yOffset), 6), k.yScale);
+
+    r = _mm256_add_epi16(luma, _mm256_mulhi_epi16(cr, k.rV));
+    g = _mm256_add_epi16(luma, _mm256_add_epi16(_mm256_mulhi_epi16(cb, k.gU), _mm256_mulhi_epi16(cr, k.gV)));
+    b = _mm256_add_epi16(luma, _mm256_mulhi_epi16(cb, k.bU));
+
+    r = _mm256_srai_epi16(_mm256_add_epi16(r, k.round), 3);
+    g = _mm256_srai_epi16(_mm256_add_epi16(g, k.round), 3);
+    b = _mm256_srai_epi16(_mm256_add_epi16(b, k.round), 3);
+}
+
+COLORCONVERTER_TARGET_AVX2
+void convertRowAvx2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+    uint8_t* destination, int width, const YuvCoefficients& c, bool rgba) {
+    Avx2Constants k;
+    k.round = _mm256_set1_epi16(4);
+    k.chromaOffset = _mm256_set1_epi16(128);
+    k.yOffset = _mm256_set1_epi16(c.yOffset);
+    k.yScale = _mm256_set1_epi16(c.yScale);
+    k.rV = _mm256_set1_epi16(c.rV);
+    k.gU = _mm256_set1_epi16(c.gU);
+    k.gV = _mm256_set1_epi16(c.gV);
+    k.bU = _mm256_set1_epi16(c.bU);
+    const __m256i alpha = _mm256_set1_epi8((char)0xff);
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i rA, gA, bA, rB, gB, bB;
+        convertPixelsAvx2(y + x, u + x / 2, v + x / 2, k, rA, gA, bA);
+        convertPixelsAvx2(y + x + 16, u + x / 2 + 8, v + x / 2 + 8, k, rB, gB, bB);
+
+        // packus works per 128-bit lane, restore pixel order afterwards
+        __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(rA, rB), 0xD8);
+        __m256i g = _mm256_permute4x64_epi64(_mm256_packus_epi16(gA, gB), 0xD8);
+        __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi16(bA, bB), 0xD8);
+
+        // Interleave into 32-bit pixels; lanes hold pixels 0-15 and 16-31
+        __m256i first = rgba ? r : b;
+        __m256i third = rgba ? b : r;
+        __m256i firstGreenLo = _mm256_unpacklo_epi8(first, g);
+        __m256i firstGreenHi = _mm256_unpackhi_epi8(first, g);
+        __m256i thirdAlphaLo = _mm256_unpacklo_epi8(third, alpha);
+        __m256i thirdAlphaHi = _mm256_unpackhi_epi8(third, alpha);
+
+        __m256i p0 = _mm256_unpacklo_epi16(firstGreenLo, thirdAlphaLo);
+        __m256i p1 = _mm256_unpackhi_epi16(firstGreenLo, thirdAlphaLo);
+        __m256i p2 = _mm256_unpacklo_epi16(firstGreenHi, thirdAlphaHi);
+        __m256i p3 = _mm256_unpackhi_epi16(firstGreenHi, thirdAlphaHi);
+
+        __m256i* out = (__m256i*)(destination + x * 4);
+        _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(p0, p1, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(p2, p3, 0x20));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(p0, p1, 0x31));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+    }
+
+    if (x < width) {
+        convertRowSse2(y + x, u + x / 2, v + x / 2, destination + x * 4, width - x, c, rgba);
+    }
+}
+
+#endif // COLORCONVERTER_X86
+
+bool isSemiPlanar(AVPixelFormat format) {
+    return format == AV_PIX_FMT_NV12 || format == AV_PIX_FMT_NV21;
+}
+
+bool isVerticallySubsampled(AVPixelFormat format) {
+    return format != AV_PIX_FMT_YUV422P && format != AV_PIX_FMT_YUVJ422P;
+}
+
+}
+
+ColorConverter::ColorConverter()
+    : sourceFormat(AV_PIX_FMT_NONE)
+    , destinationFormat(AV_PIX_FMT_NONE)
+    , width(0)
+    , coefficients()
+    , rowKernel(nullptr)
+    , kernelName("none") {
+}
+
+bool ColorConverter::isSupported(AVPixelFormat source, AVPixelFormat destination) {
+    bool sourceSupported = source == AV_PIX_FMT_YUV420P || source == AV_PIX_FMT_YUVJ420P ||
+        source == AV_PIX_FMT_YUV422P || source == AV_PIX_FMT_YUVJ422P ||
+        source == AV_PIX_FMT_NV12 || source == AV_PIX_FMT_NV21;
+    bool destinationSupported = destination == AV_PIX_FMT_RGB24 ||
+        destination == AV_PIX_FMT_RGBA || destination == AV_PIX_FMT_BGRA;
+    return sourceSupported && destinationSupported;
+}
+
+bool ColorConverter::hasKernel(ConversionKernel kernel) {
+    switch (kernel) {
+#ifdef COLORCONVERTER_X86
+    case ConversionKernel::Sse2:
+        return (av_get_cpu_flags() & AV_CPU_FLAG_SSE2) != 0;
+    case ConversionKernel::Avx2:
+        return (av_get_cpu_flags() & AV_CPU_FLAG_AVX2) != 0;
+#else
+    case ConversionKernel::Sse2:
+    case ConversionKernel::Avx2:
+        return false;
+#endif
+    default:
+        return true;
+    }
+}
+
+bool ColorConverter::configure(AVPixelFormat source, AVPixelFormat destination,
+    int pictureWidth, YuvMatrix matrix, YuvRange range, ConversionKernel kernel) {
+    rowKernel = nullptr;
+    kernelName = "none";
+    if (!isSupported(source, destination) || pictureWidth <= 0 || !hasKernel(kernel)) {
+        return false;
+    }
+
+    // The J formats are full range whatever the stream metadata says
+    if (source == AV_PIX_FMT_YUVJ420P || source == AV_PIX_FMT_YUVJ422P) {
+        range = YuvRange::Full;
+    }
+
+    sourceFormat = source;
+    destinationFormat = destination;
+    width = pictureWidth;
+    coefficients = makeCoefficients(matrix, range);
+
+    // Pick the widest kernel this CPU runs unless one was asked for
+    if (kernel == ConversionKernel::Best) {
+        kernel = hasKernel(ConversionKernel::Avx2) ? ConversionKernel::Avx2 :
+            (hasKernel(ConversionKernel::Sse2) ? ConversionKernel::Sse2 : ConversionKernel::Scalar);
+    }
+    rowKernel = convertRowScalar;
+    kernelName = "scalar";
+#ifdef COLORCONVERTER_X86
+    if (kernel == ConversionKernel::Avx2) {
+        rowKernel = convertRowAvx2;
+        kernelName = "avx2";
+    }
+    else if (kernel == ConversionKernel::Sse2) {
+        rowKernel = convertRowSse2;
+        kernelName = "sse2";
+    }
+#endif
+
+    // Scratch rows
+    int chromaWidth = (width + 1) / 2;
+    chromaU.assign(isSemiPlanar(source) ? chromaWidth : 0, 0);
+    chromaV.assign(isSemiPlanar(source) ? chromaWidth : 0, 0);
+    pixelRow.assign(destination == AV_PIX_FMT_RGB24 ? width * 4 : 0, 0);
+
+    return true;
+}
+
+void ColorConverter::convert(const uint8_t* const source[], const int sourceStride[],
+    uint8_t* destination, int destinationStride, int height) {
+    if (!rowKernel) {
+        return;
+    }
+
+    bool semiPlanar = isSemiPlanar(sourceFormat);
+    bool subsampled = isVerticallySubsampled(sourceFormat);
+    bool packRgb24 = destinationFormat == AV_PIX_FMT_RGB24;
+    bool rgba = destinationFormat != AV_PIX_FMT_BGRA;
+    int chromaWidth = (width + 1) / 2;
+    int lastChromaRow = -1;
+
+    for (int row = 0; row < height; row++) {
+        int chromaRow = subsampled ? row / 2 : row;
+        const uint8_t* yRow = source[0] + (ptrdiff_t)row * sourceStride[0];
+        const uint8_t* uRow;
+        const uint8_t* vRow;
+
+        if (semiPlanar) {
+            // Split interleaved chroma once per chroma row
+            if (chromaRow != lastChromaRow) {
+                const uint8_t* uv = source[1] + (ptrdiff_t)chromaRow * sourceStride[1];
+                int uIndex = sourceFormat == AV_PIX_FMT_NV12 ? 0 : 1;
+                for (int x = 0; x < chromaWidth; x++) {
+                    chromaU[x] = uv[x * 2 + uIndex];
+                    chromaV[x] = uv[x * 2 + 1 - uIndex];
+                }
+                lastChromaRow = chromaRow;
+            }
+            uRow = chromaU.data();
+            vRow = chromaV.data();
+        }
+        else {
+            uRow = source[1] + (ptrdiff_t)chromaRow * sourceStride[1];
+            vRow = source[2] + (ptrdiff_t)chromaRow * sourceStride[2];
+        }
+
+        uint8_t* out = destination + (ptrdiff_t)row * destinationStride;
+        if (packRgb24) {
+            // Kernels write 32-bit pixels, drop the alpha byte
+            uint8_t* pixels = pixelRow.data();
+            rowKernel(yRow, uRow, vRow, pixels, width, coefficients, true);
+            for (int x = 0; x < width; x++) {
+                out[x * 3 + 0] = pixels[x * 4 + 0];
+                out[x * 3 + 1] = pixels[x * 4 + 1];
+                out[x * 3 + 2] = pixels[x * 4 + 2];
+            }
+        }
+        else {
+            rowKernel(yRow, uRow, vRow, out, width, coefficients, rgba);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+// ColorConverter.h
+#ifndef COLORCONVERTER_H
+#define COLORCONVERTER_H
+
+#include <vector>
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+// YUV matrix and range of the source picture
+enum class YuvMatrix {
+    BT601,
+    BT709
+};
+
+enum class YuvRange {
+    Limited,
+    Full
+};
+
+// Row kernel to convert with; Best is the widest one the CPU runs
+enum class ConversionKernel {
+    Best,
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+// Fixed-point conversion coefficients (Q13, applied to samples scaled by 64)
+struct YuvCoefficients {
+    int16_t yOffset;
+    int16_t yScale;
+    int16_t rV;
+    int16_t gU;
+    int16_t gV;
+    int16_t bU;
+};
+
+// Same-size YUV to packed RGB conversion with SSE2/AVX2 kernels picked at
+// runtime from the CPU flags. Handles YUV420P, NV12/NV21 and YUV422P
+// (and their full-range J variants) to RGB24, RGBA and BGRA.
+class ColorConverter {
+public:
+    ColorConverter();
+
+    static bool isSupported(AVPixelFormat source, AVPixelFormat destination);
+    // Whether this build and CPU can run the kernel
+    static bool hasKernel(ConversionKernel kernel);
+
+    // Returns false when the format pair or the requested kernel is not
+    // available. Every kernel gives the same output.
+    bool configure(AVPixelFormat source, AVPixelFormat destination,
+        int width, YuvMatrix matrix, YuvRange range,
+        ConversionKernel kernel = ConversionKernel::Best);
+    void convert(const uint8_t* const source[], const int sourceStride[],
+        uint8_t* destination, int destinationStride, int height);
+
+    bool isConfigured() const { return rowKernel != nullptr; }
+    const char* getKernelName() const { return kernelName; }
+
+    // Converts one row of 4:2:2 sampled chroma into 32-bit pixels
+    typedef void (*RowKernel)(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+        uint8_t* destination, int width, const YuvCoefficients& coefficients, bool rgba);
+
+private:
+    AVPixelFormat sourceFormat;
+    AVPixelFormat destinationFormat;
+    int width;
+    YuvCoefficients coefficients;
+    RowKernel rowKernel;
+    const char* kernelName;
+
+    // Scratch rows for deinterleaved chroma and RGB24 packing
+    std::vector<uint8_t> chromaU;
+    std::vector<uint8_t> chromaV;
+    std::vector<uint8_t> pixelRow;
+};
+
+#endif // COLORCONVERTER_H
@@ -0,0 +1,406 @@
+// Demuxer.cpp
+#include "Demuxer.h"
+#include "Tracer.h"
+#include "Logger.h"
+#include "ProcessStats.h"
+#include <iostream>
+#include <chrono>
+
+namespace {
+// Stop reading ahead once this much compressed data is queued in total
+const int64_t MAX_QUEUED_BYTES = 16 * 1024 * 1024;
+}
+
+Demuxer::Demuxer()
+    : formatContext(nullptr)
+    , packet(nullptr)
+    , videoStreamIndex(-1)
+    , audioStreamIndex(-1)
+    , videoAttached(false)
+    , audioAttached(false)
+    , isDemuxing(false)
+    , shouldStop(false)
+    , endOfFile(false)
+    , interrupted(false) {
+}
+
+Demuxer::~Demuxer() {
+    close();
+}
+
+bool Demuxer::openFile(const std::string& filename, const DemuxerOptions& options) {
+    std::cout << "Opening media file: " << filename << std::endl;
+
+    // Close any existing file
+    close();
+
+    // stop() aborted the queues; decoders attached to this file start
+    // reading before the demux thread does, so they must not see that
+    videoQueue.start();
+    audioQueue.start();
+
+    // Slow opens and reads can be aborted through interrupt()
+    formatContext = avformat_alloc_context();
+    if (!formatContext) {
+        std::cerr << "Could not allocate format context" << std::endl;
+        return false;
+    }
+    formatContext->interrupt_callback.callback = interruptCallback;
+    formatContext->interrupt_callback.opaque = this;
+
+    AVDictionary* formatOptions = nullptr;
+    if (options.probeSize > 0) {
+        av_dict_set_int(&formatOptions, "probesize", options.probeSize, 0);
+    }
+    if (options.analyzeDuration > 0) {
+        av_dict_set_int(&formatOptions, "analyzeduration", options.analyzeDuration, 0);
+    }
+
+    // Open input file; the context is freed on failure
+    int ret = avformat_open_input(&formatContext, filename.c_str(), nullptr, &formatOptions);
+    av_dict_free(&formatOptions);
+    if (ret < 0) {
+        std::cerr << (interrupted ? "Opening cancelled: " : "Could not open input file: ") << filename << std::endl;
+        return false;
+    }
+
+    // Retrieve stream information
+    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+        std::cerr << (interrupted ? "Opening cancelled: " : "Could not find stream information: ") << filename << std::endl;
+        close();
+        return false;
+    }
+
+    // Pick the streams the decoders will use
+    videoStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    audioStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (videoStreamIndex < 0 && audioStreamIndex < 0) {
+        std::cerr << "Could not find audio or video stream" << std::endl;
+        close();
+        return false;
+    }
+
+    packet = av_packet_alloc();
+    if (!packet) {
+        std::cerr << "Could not allocate demuxer packet" << std::endl;
+        close();
+        return false;
+    }
+
+    // Index the video keyframes in the background, or load the saved index
+    if (videoStreamIndex >= 0) {
+        keyframeIndex.open(filename, videoStreamIndex, formatContext->streams[videoStreamIndex]->time_base);
+    }
+
+    endOfFile = false;
+    return true;
+}
+
+void Demuxer::close() {
+    stop();
+    keyframeIndex.close();
+
+    videoQueue.flush();
+    audioQueue.flush();
+
+    if (packet) {
+        av_packet_free(&packet);
+    }
+
+    if (formatContext) {
+        avformat_close_input(&formatContext);
+    }
+
+    videoStreamIndex = -1;
+    audioStreamIndex = -1;
+    videoAttached = false;
+    audioAttached = false;
+    endOfFile = false;
+}
+
+void Demuxer::interrupt() {
+    interrupted = true;
+}
+
+int Demuxer::interruptCallback(void* opaque) {
+    return static_cast<Demuxer*>(opaque)->interrupted ? 1 : 0;
+}
+
+bool Demuxer::isFileOpen() const {
+    return formatContext != nullptr;
+}
+
+AVFormatContext* Demuxer::getFormatContext() const {
+    return formatContext;
+}
+
+AVStream* Demuxer::getStream(AVMediaType type) const {
+    int index = -1;
+    if (type == AVMEDIA_TYPE_VIDEO) {
+        index = videoStreamIndex;
+    }
+    else if (type == AVMEDIA_TYPE_AUDIO) {
+        index = audioStreamIndex;
+    }
+
+    return index >= 0 ? formatContext->streams[index] : nullptr;
+}
+
+PacketQueue* Demuxer::attachStream(AVMediaType type) {
+    std::lock_guard<std::mutex> lock(demuxMutex);
+
+    PacketQueue* queue = nullptr;
+    if (type == AVMEDIA_TYPE_VIDEO && videoStreamIndex >= 0) {
+        videoAttached = true;
+        queue = &videoQueue;
+    }
+    else if (type == AVMEDIA_TYPE_AUDIO && audioStreamIndex >= 0) {
+        audioAttached = true;
+        queue = &audioQueue;
+    }
+
+    updateDiscard();
+    return queue;
+}
+
+void Demuxer::detachStream(AVMediaType type) {
+    std::lock_guard<std::mutex> lock(demuxMutex);
+
+    if (type == AVMEDIA_TYPE_VIDEO) {
+        videoAttached = false;
+        videoQueue.flush();
+    }
+    else if (type == AVMEDIA_TYPE_AUDIO) {
+        audioAttached = false;
+        audioQueue.flush();
+    }
+
+    updateDiscard();
+    wakeCondition.notify_all();
+}
+
+void Demuxer::updateDiscard() {
+    if (!formatContext) {
+        return;
+    }
+
+    // Let the demuxer skip streams nobody decodes
+    for (unsigned int i = 0; i < formatContext->nb_streams; i++) {
+        bool used = ((int)i == videoStreamIndex && videoAttached) ||
+            ((int)i == audioStreamIndex && audioAttached);
+        formatContext->streams[i]->discard = used ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+}
+
+bool Demuxer::start() {
+    if (!formatContext) {
+        return false;
+    }
+    if (isDemuxing) {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(demuxMutex);
+        updateDiscard();
+    }
+
+    videoQueue.start();
+    audioQueue.start();
+
+    shouldStop = false;
+    isDemuxing = true;
+    demuxThread = std::thread(&Demuxer::demuxLoop, this);
+    return true;
+}
+
+void Demuxer::stop() {
+    if (!isDemuxing) {
+        return;
+    }
+
+    // Wake the demux thread and any decoder blocked on a queue
+    {
+        std::lock_guard<std::mutex> lock(demuxMutex);
+        shouldStop = true;
+    }
+    videoQueue.abort();
+    audioQueue.abort();
+    wakeCondition.notify_all();
+
+    if (demuxThread.joinable()) {
+        demuxThread.join();
+    }
+
+    isDemuxing = false;
+}
+
+bool Demuxer::shouldThrottle() const {
+    if (videoQueue.byteSize() + audioQueue.byteSize() > MAX_QUEUED_BYTES) {
+        return true;
+    }
+
+    // Keep reading while any consumer is about to run dry, even if another
+    // queue is already full (badly interleaved files)
+    bool anyFull = false;
+    bool anyStarving = false;
+    if (videoAttached) {
+        anyFull |= videoQueue.isFull();
+        anyStarving |= videoQueue.isStarving();
+    }
+    if (audioAttached) {
+        anyFull |= audioQueue.isFull();
+        anyStarving |= audioQueue.isStarving();
+    }
+
+    return (anyFull && !anyStarving) || (!videoAttached && !audioAttached);
+}
+
+PacketQueue* Demuxer::queueForStream(int streamIndex) {
+    if (streamIndex == videoStreamIndex && videoAttached) {
+        return &videoQueue;
+    }
+    if (streamIndex == audioStreamIndex && audioAttached) {
+        return &audioQueue;
+    }
+    return nullptr;
+}
+
+void Demuxer::demuxLoop() {
+    std::cout << "Demuxing thread started" << std::endl;
+    TRACE_THREAD_NAME("demux");
+
+    while (!shouldStop) {
+        std::unique_lock<std::mutex> lock(demuxMutex);
+
+        // Nothing more to read until a seek rewinds the file
+        if (endOfFile) {
+            wakeCondition.wait(lock, [this] { return !endOfFile || shouldStop; });
+            continue;
+        }
+
+        // Queues are full enough, wait for the decoders to catch up
+        if (shouldThrottle()) {
+            wakeCondition.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        TRACE_SCOPE("demux");
+        int ret = av_read_frame(formatContext, packet);
+        if (ret < 0) {
+            if (ret == AVERROR_EOF || (formatContext->pb && avio_feof(formatContext->pb))) {
+                // Tell the decoders to drain
+                if (videoAttached) {
+                    videoQueue.putEndOfStream();
+                }
+                if (audioAttached) {
+                    audioQueue.putEndOfStream();
+                }
+                endOfFile = true;
+                LOG_INFO("End of file reached");
+            }
+            else {
+                wakeCondition.wait_for(lock, std::chrono::milliseconds(10));
+            }
+            continue;
+        }
+
+        PacketQueue* queue = queueForStream(packet->stream_index);
+        if (queue) {
+            queue->put(packet);
+        }
+        else {
+            av_packet_unref(packet);
+        }
+    }
+
+    std::cout << "Demuxing thread ended" << std::endl;
+}
+
+bool Demuxer::seekToTime(double seconds) {
+    if (!formatContext) {
+        return false;
+    }
+
+    // Holding the demux lock means no packet from before the seek can be
+    // queued after the flush below
+    std::lock_guard<std::mutex> lock(demuxMutex);
+
+    if (!seekToKeyframe(seconds)) {
+        int64_t timestamp = (int64_t)(seconds * AV_TIME_BASE);
+        if (av_seek_frame(formatContext, -1, timestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+            LOG_ERROR("Error seeking to time: %g", seconds);
+            return false;
+        }
+    }
+
+    videoQueue.flush();
+    audioQueue.flush();
+    endOfFile = false;
+    wakeCondition.notify_all();
+
+    return true;
+}
+
+bool Demuxer::seekToKeyframe(double seconds) {
+    if (videoStreamIndex < 0) {
+        return false;
+    }
+
+    AVStream* stream = formatContext->streams[videoStreamIndex];
+    int64_t target = av_rescale_q((int64_t)(seconds * AV_TIME_BASE), AV_TIME_BASE_Q, stream->time_base);
+
+    KeyframeEntry keyframe;
+    if (!keyframeIndex.findByPts(target, keyframe)) {
+        return false;
+    }
+
+    // Files without an index of their own would be scanned, so jump to the
+    // packet directly where the format allows byte positions
+    bool byteSeek = keyframe.position >= 0 &&
+        avformat_index_get_entries_count(stream) == 0 &&
+        !(formatContext->iformat->flags & AVFMT_NO_BYTE_SEEK);
+    if (byteSeek && av_seek_frame(formatContext, videoStreamIndex, keyframe.position, AVSEEK_FLAG_BYTE) >= 0) {
+        return true;
+    }
+
+    return av_seek_frame(formatContext, videoStreamIndex, keyframe.pts, AVSEEK_FLAG_BACKWARD) >= 0;
+}
+
+bool Demuxer::hasEnded() const {
+    return endOfFile;
+}
+
+size_t Demuxer::getQueuedPackets(AVMediaType type) const {
+    if (type == AVMEDIA_TYPE_VIDEO) {
+        return videoQueue.size();
+    }
+    if (type == AVMEDIA_TYPE_AUDIO) {
+        return audioQueue.size();
+    }
+    return 0;
+}
+
+double Demuxer::getThreadCpuTime() {
+    return ::getThreadCpuTime(demuxThread);
+}
+
+double Demuxer::getFrameTime(int64_t frameNumber) const {
+    AVStream* stream = getStream(AVMEDIA_TYPE_VIDEO);
+    if (!stream || frameNumber < 0) {
+        return 0.0;
+    }
+
+    AVRational frameRate = av_guess_frame_rate(formatContext, stream, nullptr);
+    double frameDuration = frameRate.num > 0 ? av_q2d(av_inv_q(frameRate)) : 0.0;
+    double startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time * av_q2d(stream->time_base) : 0.0;
+
+    // Count on from the nearest indexed keyframe, which keeps variable
+    // frame rate files from drifting
+    KeyframeEntry keyframe;
+    if (keyframeIndex.findByFrame(frameNumber, keyframe)) {
+        return keyframe.pts * av_q2d(stream->time_base) +
+            (frameNumber - keyframe.frameNumber) * frameDuration;
+    }
+    return startTime + frameNumber * frameDuration;
+}
@@ -0,0 +1,100 @@
+// Demuxer.h
+#ifndef DEMUXER_H
+#define DEMUXER_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include "PacketQueue.h"
+#include "KeyframeIndex.h"
+
+// Container probing limits; zero keeps FFmpeg's defaults. Smaller values
+// open faster but may miss streams that only start later in the file.
+struct DemuxerOptions {
+    int64_t probeSize = 0;          // Bytes read to detect the format and streams
+    int64_t analyzeDuration = 0;    // Microseconds analyzed for stream parameters
+};
+
+// Owns the single AVFormatContext of the open file and reads it on one
+// thread, routing each packet to the queue of the decoder that uses it.
+// Streams no decoder attached to are discarded inside the demuxer.
+class Demuxer {
+public:
+    Demuxer();
+    ~Demuxer();
+
+    bool openFile(const std::string& filename, const DemuxerOptions& options = DemuxerOptions());
+    void close();
+    bool isFileOpen() const;
+
+    // Aborts a blocking open or read from another thread. The request
+    // holds across close() and openFile(), so a cancel cannot be lost while
+    // an open is starting; an interrupted demuxer cannot be reused.
+    void interrupt();
+
+    // Stream access for decoders; decoders must be closed before the demuxer
+    AVFormatContext* getFormatContext() const;
+    AVStream* getStream(AVMediaType type) const;
+    PacketQueue* attachStream(AVMediaType type);
+    void detachStream(AVMediaType type);
+
+    // Demux thread control
+    bool start();
+    void stop();
+
+    // Seeking (flushes every packet queue). With the keyframe index ready
+    // the file is positioned on the keyframe starting the target's GOP;
+    // decoders then drop what comes before the target themselves.
+    bool seekToTime(double seconds);
+    bool hasEnded() const;
+
+    // Packets waiting in the queue of a stream's decoder
+    size_t getQueuedPackets(AVMediaType type) const;
+
+    // CPU seconds used by the demux thread while it runs
+    double getThreadCpuTime();
+
+    // Presentation time of a video frame, exact once the index is ready
+    double getFrameTime(int64_t frameNumber) const;
+    const KeyframeIndex& getKeyframeIndex() const { return keyframeIndex; }
+
+private:
+    // FFmpeg components
+    AVFormatContext* formatContext;
+    AVPacket* packet;
+
+    // Stream routing
+    int videoStreamIndex;
+    int audioStreamIndex;
+    bool videoAttached;
+    bool audioAttached;
+    PacketQueue videoQueue;
+    PacketQueue audioQueue;
+    KeyframeIndex keyframeIndex;
+
+    // Threading and synchronization
+    std::thread demuxThread;
+    std::atomic<bool> isDemuxing;
+    std::atomic<bool> shouldStop;
+    std::atomic<bool> endOfFile;
+    std::atomic<bool> interrupted;
+    std::mutex demuxMutex;
+    std::condition_variable wakeCondition;
+
+    // Private methods
+    static int interruptCallback(void* opaque);
+    void demuxLoop();
+    bool seekToKeyframe(double seconds);
+    bool shouldThrottle() const;
+    void updateDiscard();
+    PacketQueue* queueForStream(int streamIndex);
+};
+
+#endif // DEMUXER_H
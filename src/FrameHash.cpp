@@ -0,0 +1,507 @@
+// FrameHash.cpp
+#include "FrameHash.h"
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cinttypes>
+#include <cmath>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/md5.h>
+#include <libavutil/mem.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/rational.h>
+}
+
+namespace {
+const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Input is read little-endian, as on every platform the player targets
+inline uint64_t read64(const uint8_t* data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint32_t read32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint64_t xxhRound(uint64_t accumulator, uint64_t input) {
+    accumulator += input * PRIME2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * PRIME1;
+}
+
+inline uint64_t xxhMerge(uint64_t hash, uint64_t accumulator) {
+    hash ^= xxhRound(0, accumulator);
+    return hash * PRIME1 + PRIME4;
+}
+
+const char* MEDIA_STREAM_VIDEO = "0";
+const char* MEDIA_STREAM_AUDIO = "1";
+
+// Checksum line fields without the padding, for comparing
+bool splitLine(const std::string& line, std::string& key, std::string& hash) {
+    std::string fields[6];
+    size_t count = 0;
+    size_t start = 0;
+    while (count < 6) {
+        size_t end = line.find(',', start);
+        std::string field = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        size_t first = field.find_first_not_of(" \t\r");
+        size_t last = field.find_last_not_of(" \t\r");
+        fields[count++] = first == std::string::npos ? "" : field.substr(first, last - first + 1);
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    if (count < 6) {
+        return false;
+    }
+
+    // Stream and pts say which frame it is, size and hash what it holds
+    key = "stream " + fields[0] + " pts " + fields[2];
+    hash = fields[4] + " " + fields[5];
+    return true;
+}
+
+// Checksum lines of a file split by stream, header skipped; false if it
+// cannot be read
+bool readHashFile(const std::string& path, std::vector<std::string> streams[2], std::string& hashName) {
+    std::ifstream input(path);
+    if (!input) {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(input, line)) {
+        if (line.compare(0, 7, "#hash: ") == 0) {
+            hashName = line.substr(7);
+        }
+        if (!line.empty() && line[0] != '#') {
+            streams[line[0] == '0' ? 0 : 1].push_back(line);
+        }
+    }
+    return true;
+}
+}
+
+Xxh64::Xxh64() {
+    reset();
+}
+
+void Xxh64::reset() {
+    accumulators[0] = PRIME1 + PRIME2;
+    accumulators[1] = PRIME2;
+    accumulators[2] = 0;
+    accumulators[3] = 0 - PRIME1;
+    pendingSize = 0;
+    totalSize = 0;
+}
+
+void Xxh64::update(const uint8_t* data, size_t size) {
+    totalSize += size;
+
+    // Top up a partial stripe first
+    if (pendingSize > 0) {
+        size_t count = std::min(size, sizeof(pending) - pendingSize);
+        memcpy(pending + pendingSize, data, count);
+        pendingSize += count;
+        data += count;
+        size -= count;
+        if (pendingSize < sizeof(pending)) {
+            return;
+        }
+        for (int i = 0; i < 4; i++) {
+            accumulators[i] = xxhRound(accumulators[i], read64(pending + i * 8));
+        }
+        pendingSize = 0;
+    }
+
+    // Whole 32-byte stripes straight from the input
+    while (size >= 32) {
+        accumulators[0] = xxhRound(accumulators[0], read64(data));
+        accumulators[1] = xxhRound(accumulators[1], read64(data + 8));
+        accumulators[2] = xxhRound(accumulators[2], read64(data + 16));
+        accumulators[3] = xxhRound(accumulators[3], read64(data + 24));
+        data += 32;
+        size -= 32;
+    }
+
+    memcpy(pending, data, size);
+    pendingSize = size;
+}
+
+uint64_t Xxh64::digest() const {
+    uint64_t hash;
+    if (totalSize >= 32) {
+        hash = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7) +
+            rotateLeft(accumulators[2], 12) + rotateLeft(accumulators[3], 18);
+        for (int i = 0; i < 4; i++) {
+            hash = xxhMerge(hash, accumulators[i]);
+        }
+    }
+    else {
+        hash = PRIME5;
+    }
+    hash += totalSize;
+
+    const uint8_t* data = pending;
+    size_t size = pendingSize;
+    while (size >= 8) {
+        hash ^= xxhRound(0, read64(data));
+        hash = rotateLeft(hash, 27) * PRIME1 + PRIME4;
+        data += 8;
+        size -= 8;
+    }
+    if (size >= 4) {
+        hash ^= (uint64_t)read32(data) * PRIME1;
+        hash = rotateLeft(hash, 23) * PRIME2 + PRIME3;
+        data += 4;
+        size -= 4;
+    }
+    while (size > 0) {
+        hash ^= (*data) * PRIME5;
+        hash = rotateLeft(hash, 11) * PRIME1;
+        data++;
+        size--;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+FrameHash::FrameHash(HashAlgorithm algorithm)
+    : algorithm(algorithm)
+    , md5(nullptr) {
+    if (algorithm == HashAlgorithm::MD5) {
+        md5 = av_md5_alloc();
+    }
+    reset();
+}
+
+FrameHash::~FrameHash() {
+    av_freep(&md5);
+}
+
+void FrameHash::reset() {
+    if (md5) {
+        av_md5_init(md5);
+    }
+    else {
+        xxh64.reset();
+    }
+}
+
+void FrameHash::update(const uint8_t* data, size_t size) {
+    if (md5) {
+        av_md5_update(md5, data, size);
+    }
+    else {
+        xxh64.update(data, size);
+    }
+}
+
+void FrameHash::finish(char* hex) {
+    if (md5) {
+        uint8_t digest[16];
+        av_md5_final(md5, digest);
+        for (int i = 0; i < 16; i++) {
+            snprintf(hex + i * 2, 3, "%02x", digest[i]);
+        }
+    }
+    else {
+        snprintf(hex, MAX_HEX_LENGTH + 1, "%016" PRIx64, xxh64.digest());
+    }
+}
+
+const char* FrameHash::getAlgorithmName(HashAlgorithm algorithm) {
+    switch (algorithm) {
+    case HashAlgorithm::MD5: return "MD5";
+    case HashAlgorithm::XXH64: return "XXH64";
+    default: return "unknown";
+    }
+}
+
+bool FrameHash::parseAlgorithm(const std::string& name, HashAlgorithm& algorithm) {
+    if (name == "md5" || name == "MD5") {
+        algorithm = HashAlgorithm::MD5;
+        return true;
+    }
+    if (name == "xxh64" || name == "XXH64") {
+        algorithm = HashAlgorithm::XXH64;
+        return true;
+    }
+    return false;
+}
+
+FrameHashWriter::FrameHashWriter(const std::string& path, HashAlgorithm algorithm)
+    : path(path)
+    , algorithm(algorithm)
+    , headerWritten(false)
+    , lines(0)
+    , hasVideo(false)
+    , videoOpen(false)
+    , width(0)
+    , height(0)
+    , frameRateNum(0)
+    , frameRateDen(1)
+    , hasAudio(false)
+    , audioOpen(false)
+    , sampleRate(0)
+    , channels(0) {
+}
+
+FrameHashWriter::~FrameHashWriter() {
+    close();
+}
+
+void FrameHashWriter::setVideoStream(int videoWidth, int videoHeight, double frameRate) {
+    AVRational rate = av_d2q(frameRate > 0.0 ? frameRate : 25.0, 1000000);
+    hasVideo = true;
+    videoOpen = true;
+    width = videoWidth;
+    height = videoHeight;
+    frameRateNum = rate.num;
+    frameRateDen = rate.den;
+}
+
+void FrameHashWriter::setAudioStream(int rate, int channelCount) {
+    hasAudio = true;
+    audioOpen = true;
+    sampleRate = rate;
+    channels = channelCount;
+}
+
+bool FrameHashWriter::writeHeader() {
+    file.open(path, std::ios::trunc);
+    if (!file) {
+        std::cerr << "Could not open checksum file: " << path << std::endl;
+        return false;
+    }
+
+    // Video time base is one frame, audio time base one sample
+    file << "#format: frame checksums\n#version: 2\n#hash: " << FrameHash::getAlgorithmName(algorithm) << "\n";
+    if (hasVideo) {
+        file << "#tb " << MEDIA_STREAM_VIDEO << ": " << frameRateDen << "/" << frameRateNum << "\n"
+            << "#media_type " << MEDIA_STREAM_VIDEO << ": video\n"
+            << "#codec_id " << MEDIA_STREAM_VIDEO << ": rawvideo\n"
+            << "#dimensions " << MEDIA_STREAM_VIDEO << ": " << width << "x" << height << "\n"
+            << "#sar " << MEDIA_STREAM_VIDEO << ": 1/1\n";
+    }
+    if (hasAudio) {
+        file << "#tb " << MEDIA_STREAM_AUDIO << ": 1/" << sampleRate << "\n"
+            << "#media_type " << MEDIA_STREAM_AUDIO << ": audio\n"
+            << "#codec_id " << MEDIA_STREAM_AUDIO << ": pcm_s16le\n"
+            << "#sample_rate " << MEDIA_STREAM_AUDIO << ": " << sampleRate << "\n"
+            << "#channel_layout_name " << MEDIA_STREAM_AUDIO << ": " << (channels == 2 ? "stereo" : "mono") << "\n";
+    }
+    file << "#stream#, dts,        pts, duration,     size, hash\n";
+
+    headerWritten = true;
+    return true;
+}
+
+bool FrameHashWriter::writeLine(int stream, int64_t pts, int64_t duration, size_t size, const char* hex) {
+    if (!headerWritten && !writeHeader()) {
+        return false;
+    }
+
+    char line[128];
+    snprintf(line, sizeof(line), "%d, %10" PRId64 ", %10" PRId64 ", %8" PRId64 ", %8d, %s\n",
+        stream, pts, pts, duration, (int)size, hex);
+    streamLines[stream == 0 ? 0 : 1].emplace_back(line);
+    lines++;
+    return true;
+}
+
+void FrameHashWriter::closeStream(int stream) {
+    if (stream == 0) {
+        videoOpen = false;
+    }
+    else {
+        audioOpen = false;
+    }
+
+    // The audio sink still holds its last chunk when the video closes
+    if (!videoOpen && !audioOpen) {
+        close();
+    }
+}
+
+void FrameHashWriter::close() {
+    if (file.is_open()) {
+        for (std::vector<std::string>& stream : streamLines) {
+            for (const std::string& line : stream) {
+                file << line;
+            }
+            stream.clear();
+        }
+        file.close();
+        if (!file) {
+            std::cerr << "Writing checksum file failed: " << path << std::endl;
+        }
+        std::cout << "Checksums: " << lines << " frames (" << FrameHash::getAlgorithmName(algorithm)
+            << ") written to " << path << std::endl;
+    }
+}
+
+HashVideoSink::HashVideoSink(std::shared_ptr<FrameHashWriter> writer)
+    : writer(writer)
+    , hash(writer->getAlgorithm())
+    , frameRate(0.0) {
+}
+
+bool HashVideoSink::open(int width, int height, double rate) {
+    frameRate = rate > 0.0 ? rate : 25.0;
+    writer->setVideoStream(width, height, frameRate);
+    return true;
+}
+
+bool HashVideoSink::writePicture(const AVFrame* frame, double pts) {
+    AVPixelFormat format = (AVPixelFormat)frame->format;
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(format);
+    if (!descriptor) {
+        return false;
+    }
+
+    // Only the visible bytes of each row count, padding differs between runs
+    hash.reset();
+    size_t size = 0;
+    int planes = av_pix_fmt_count_planes(format);
+    for (int plane = 0; plane < planes; plane++) {
+        int rowBytes = av_image_get_linesize(format, frame->width, plane);
+        int rows = frame->height;
+        if (plane == 1 || plane == 2) {
+            rows = -((-rows) >> descriptor->log2_chroma_h);
+        }
+        for (int y = 0; y < rows; y++) {
+            hash.update(frame->data[plane] + (size_t)y * frame->linesize[plane], rowBytes);
+        }
+        size += (size_t)rowBytes * rows;
+    }
+
+    char hex[FrameHash::MAX_HEX_LENGTH + 1];
+    hash.finish(hex);
+    framesWritten++;
+    return writer->writeLine(0, (int64_t)std::llround(pts * frameRate), 1, size, hex);
+}
+
+void HashVideoSink::close() {
+    writer->closeStream(0);
+}
+
+HashAudioSink::HashAudioSink(std::shared_ptr<FrameHashWriter> writer)
+    : writer(writer)
+    , hash(writer->getAlgorithm())
+    , channels(0)
+    , chunkFrames(0) {
+}
+
+bool HashAudioSink::open(int sampleRate, int channelCount) {
+    channels = channelCount;
+    chunk.resize(CHUNK_FRAMES * channels);
+    chunkFrames = 0;
+    writer->setAudioStream(sampleRate, channels);
+    return true;
+}
+
+bool HashAudioSink::writeSamples(const int16_t* samples, size_t frames) {
+    while (frames > 0) {
+        size_t count = std::min(frames, CHUNK_FRAMES - chunkFrames);
+        memcpy(chunk.data() + chunkFrames * channels, samples, count * channels * sizeof(int16_t));
+        chunkFrames += count;
+        samples += count * channels;
+        frames -= count;
+
+        if (chunkFrames == CHUNK_FRAMES && !writeChunk()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HashAudioSink::writeChunk() {
+    size_t size = chunkFrames * channels * sizeof(int16_t);
+    hash.reset();
+    hash.update(reinterpret_cast<const uint8_t*>(chunk.data()), size);
+
+    char hex[FrameHash::MAX_HEX_LENGTH + 1];
+    hash.finish(hex);
+    bool written = writer->writeLine(1, (int64_t)framesWritten, (int64_t)chunkFrames, size, hex);
+    framesWritten += chunkFrames;
+    chunkFrames = 0;
+    return written;
+}
+
+void HashAudioSink::close() {
+    // The last chunk is usually short
+    if (chunkFrames > 0) {
+        writeChunk();
+    }
+    writer->closeStream(1);
+}
+
+bool compareFrameHashes(const std::string& expectedPath, const std::string& actualPath) {
+    std::vector<std::string> expected[2];
+    std::vector<std::string> actual[2];
+    std::string expectedHash, actualHash;
+    if (!readHashFile(expectedPath, expected, expectedHash) || !readHashFile(actualPath, actual, actualHash)) {
+        return false;
+    }
+    if (expectedHash != actualHash) {
+        std::cerr << "Checksums use different hashes: " << expectedHash << " and " << actualHash << std::endl;
+        return false;
+    }
+
+    // Lines are matched by their place within each stream, so files that
+    // interleave the streams differently still compare equal
+    uint64_t frames = 0;
+    for (int stream = 0; stream < 2; stream++) {
+        size_t count = std::min(expected[stream].size(), actual[stream].size());
+        for (size_t i = 0; i < count; i++) {
+            std::string expectedKey, expectedValue, actualKey, actualValue;
+            if (!splitLine(expected[stream][i], expectedKey, expectedValue) ||
+                !splitLine(actual[stream][i], actualKey, actualValue)) {
+                std::cerr << "Stream " << stream << " frame " << i << ": malformed checksum line" << std::endl;
+                return false;
+            }
+            if (expectedKey != actualKey || expectedValue != actualValue) {
+                std::cout << "First difference at stream " << stream << " frame " << i
+                    << " (" << expectedKey << ")" << std::endl
+                    << "  " << expectedPath << ": " << expected[stream][i] << std::endl
+                    << "  " << actualPath << ": " << actual[stream][i] << std::endl;
+                return false;
+            }
+        }
+        if (expected[stream].size() != actual[stream].size()) {
+            bool expectedShorter = expected[stream].size() < actual[stream].size();
+            std::cout << "Stream " << stream << " frame " << count << ": "
+                << (expectedShorter ? expectedPath : actualPath) << " ends early" << std::endl;
+            return false;
+        }
+        frames += count;
+    }
+
+    std::cout << "Checksums match: " << frames << " frames" << std::endl;
+    return true;
+}
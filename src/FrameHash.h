@@ -0,0 +1,144 @@
+// FrameHash.h
+#ifndef FRAMEHASH_H
+#define FRAMEHASH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+
+#include "OutputSink.h"
+
+struct AVMD5;
+
+enum class HashAlgorithm {
+    MD5,    // What ffmpeg -f framemd5 writes
+    XXH64   // Several times faster, for hashing at full decode speed
+};
+
+// Streaming XXH64 with seed 0
+class Xxh64 {
+public:
+    Xxh64();
+
+    void reset();
+    void update(const uint8_t* data, size_t size);
+    uint64_t digest() const;
+
+private:
+    uint64_t accumulators[4];
+    uint8_t pending[32];
+    size_t pendingSize;
+    uint64_t totalSize;
+};
+
+// One hash over any number of updates, as lowercase hex
+class FrameHash {
+public:
+    static const int MAX_HEX_LENGTH = 32;
+
+    explicit FrameHash(HashAlgorithm algorithm);
+    ~FrameHash();
+
+    void reset();
+    void update(const uint8_t* data, size_t size);
+    // Writes MAX_HEX_LENGTH + 1 characters at most
+    void finish(char* hex);
+
+    static const char* getAlgorithmName(HashAlgorithm algorithm);
+    static bool parseAlgorithm(const std::string& name, HashAlgorithm& algorithm);
+
+private:
+    HashAlgorithm algorithm;
+    AVMD5* md5;
+    Xxh64 xxh64;
+};
+
+// Per-frame checksums in the text layout of ffmpeg's framemd5 muxer.
+// Stream 0 is video, stream 1 audio; the header goes out with the first
+// line, once both sinks have described their streams. Bench mode feeds
+// the two sinks in no fixed order, so the lines are held per stream and
+// written on close, all of stream 0 before stream 1, when the last open
+// stream closes.
+class FrameHashWriter {
+public:
+    FrameHashWriter(const std::string& path, HashAlgorithm algorithm);
+    ~FrameHashWriter();
+
+    void setVideoStream(int width, int height, double frameRate);
+    void setAudioStream(int sampleRate, int channels);
+
+    bool writeLine(int stream, int64_t pts, int64_t duration, size_t size, const char* hex);
+    void closeStream(int stream);
+
+    HashAlgorithm getAlgorithm() const { return algorithm; }
+    const std::string& getPath() const { return path; }
+
+private:
+    std::string path;
+    HashAlgorithm algorithm;
+    std::ofstream file;
+    bool headerWritten;
+    uint64_t lines;
+    std::vector<std::string> streamLines[2];
+
+    bool hasVideo;
+    bool videoOpen;
+    int width;
+    int height;
+    int frameRateNum;
+    int frameRateDen;
+    bool hasAudio;
+    bool audioOpen;
+    int sampleRate;
+    int channels;
+
+    bool writeHeader();
+    void close();
+};
+
+// Hashes every picture over its visible pixels, plane by plane
+class HashVideoSink : public VideoSink {
+public:
+    HashVideoSink(std::shared_ptr<FrameHashWriter> writer);
+
+    bool open(int width, int height, double frameRate) override;
+    bool writePicture(const AVFrame* frame, double pts) override;
+    void close() override;
+    const char* getName() const override { return "hash"; }
+
+private:
+    std::shared_ptr<FrameHashWriter> writer;
+    FrameHash hash;
+    double frameRate;
+};
+
+// Hashes audio in fixed chunks, so the result does not depend on how
+// the samples were pulled
+class HashAudioSink : public AudioSink {
+public:
+    static const size_t CHUNK_FRAMES = 1024;
+
+    HashAudioSink(std::shared_ptr<FrameHashWriter> writer);
+
+    bool open(int sampleRate, int channels) override;
+    bool writeSamples(const int16_t* samples, size_t frames) override;
+    void close() override;
+    const char* getName() const override { return "hash"; }
+
+private:
+    std::shared_ptr<FrameHashWriter> writer;
+    FrameHash hash;
+    int channels;
+    std::vector<int16_t> chunk;
+    size_t chunkFrames;
+
+    bool writeChunk();
+};
+
+// Compares two checksum files stream by stream, in order within each
+// stream, and reports the first frame that differs; true if they match
+bool compareFrameHashes(const std::string& expectedPath, const std::string& actualPath);
+
+#endif // FRAMEHASH_H
@@ -0,0 +1,168 @@
+// FramePool.cpp
+#include "FramePool.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/mem.h>
+}
+
+namespace {
+    // Room in front of each allocation to remember its size for the stats
+    const size_t kHeaderSize = 64;
+    const int kLineAlign = 64;
+    // Decoders and SIMD code may read a little past the last plane
+    const size_t kTailPadding = 64;
+}
+
+FramePool::FramePool()
+    : pool(nullptr)
+    , poolWidth(0)
+    , poolHeight(0)
+    , poolFormat(AV_PIX_FMT_NONE)
+    , linesizes{}
+    , planeOffsets{}
+    , requests(0)
+    , misses(0)
+    , liveBytes(0)
+    , peakBytes(0) {
+}
+
+FramePool::~FramePool() {
+    reset();
+}
+
+bool FramePool::getBuffer(AVFrame* frame, int width, int height, AVPixelFormat format) {
+    frame->width = width;
+    frame->height = height;
+    frame->format = format;
+    return fillFrame(frame, width, height, format);
+}
+
+int FramePool::getCodecBuffer(AVCodecContext* context, AVFrame* frame, int flags) {
+    FramePool* framePool = static_cast<FramePool*>(context->opaque);
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+
+    // Hardware surfaces, palettes and audio stay with the default allocator
+    if (!framePool || !descriptor || frame->width <= 0 || frame->height <= 0 ||
+        (descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+        return avcodec_default_get_buffer2(context, frame, flags);
+    }
+
+    // Codecs write into the padded area around the visible picture
+    int width = frame->width;
+    int height = frame->height;
+    int strideAlign[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(context, &width, &height, strideAlign);
+
+    if (!framePool->fillFrame(frame, width, height, (AVPixelFormat)frame->format)) {
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+bool FramePool::fillFrame(AVFrame* frame, int width, int height, AVPixelFormat format) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!pool || width != poolWidth || height != poolHeight || format != poolFormat) {
+        int newLinesizes[4];
+        if (av_image_fill_linesizes(newLinesizes, format, width) < 0) {
+            return false;
+        }
+
+        ptrdiff_t alignedLinesizes[4];
+        for (int i = 0; i < 4; i++) {
+            newLinesizes[i] = FFALIGN(newLinesizes[i], kLineAlign);
+            alignedLinesizes[i] = newLinesizes[i];
+        }
+
+        size_t planeSizes[4];
+        if (av_image_fill_plane_sizes(planeSizes, format, height, alignedLinesizes) < 0) {
+            return false;
+        }
+
+        size_t totalSize = 0;
+        for (int i = 0; i < 4; i++) {
+            linesizes[i] = newLinesizes[i];
+            planeOffsets[i] = totalSize;
+            totalSize += planeSizes[i];
+        }
+
+        // Buffers still held by frames are freed when they come back
+        av_buffer_pool_uninit(&pool);
+        pool = av_buffer_pool_init2(totalSize + kTailPadding, this, allocateBuffer, nullptr);
+        if (!pool) {
+            poolFormat = AV_PIX_FMT_NONE;
+            return false;
+        }
+        poolWidth = width;
+        poolHeight = height;
+        poolFormat = format;
+    }
+
+    AVBufferRef* buffer = av_buffer_pool_get(pool);
+    if (!buffer) {
+        return false;
+    }
+    requests++;
+
+    frame->buf[0] = buffer;
+    for (int i = 0; i < 4; i++) {
+        frame->linesize[i] = linesizes[i];
+        frame->data[i] = linesizes[i] ? buffer->data + planeOffsets[i] : nullptr;
+    }
+    frame->extended_data = frame->data;
+    return true;
+}
+
+AVBufferRef* FramePool::allocateBuffer(void* opaque, size_t size) {
+    FramePool* framePool = static_cast<FramePool*>(opaque);
+
+    uint8_t* base = static_cast<uint8_t*>(av_malloc(size + kHeaderSize));
+    if (!base) {
+        return nullptr;
+    }
+    *reinterpret_cast<size_t*>(base) = size;
+
+    AVBufferRef* buffer = av_buffer_create(base + kHeaderSize, size, freeBuffer, framePool, 0);
+    if (!buffer) {
+        av_free(base);
+        return nullptr;
+    }
+
+    framePool->misses++;
+    int64_t live = framePool->liveBytes += (int64_t)size;
+    int64_t peak = framePool->peakBytes.load();
+    while (live > peak && !framePool->peakBytes.compare_exchange_weak(peak, live)) {
+    }
+    return buffer;
+}
+
+void FramePool::freeBuffer(void* opaque, uint8_t* data) {
+    FramePool* framePool = static_cast<FramePool*>(opaque);
+    uint8_t* base = data - kHeaderSize;
+    framePool->liveBytes -= (int64_t)*reinterpret_cast<size_t*>(base);
+    av_free(base);
+}
+
+void FramePool::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    av_buffer_pool_uninit(&pool);
+    poolWidth = 0;
+    poolHeight = 0;
+    poolFormat = AV_PIX_FMT_NONE;
+
+    // Buffers still out keep counting towards the live bytes
+    requests = 0;
+    misses = 0;
+    peakBytes = liveBytes.load();
+}
+
+FramePoolStats FramePool::getStats() const {
+    FramePoolStats stats;
+    stats.requests = requests.load();
+    stats.misses = misses.load();
+    stats.liveBytes = liveBytes.load();
+    stats.peakBytes = peakBytes.load();
+    return stats;
+}
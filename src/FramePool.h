@@ -0,0 +1,61 @@
+// FramePool.h
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+}
+
+struct FramePoolStats {
+    uint64_t requests;      // Buffers handed out
+    uint64_t misses;        // Requests that had to allocate
+    int64_t liveBytes;      // Allocated and not yet freed, pooled or in use
+    int64_t peakBytes;
+};
+
+// Reference-counted picture buffers recycled through an AVBufferPool.
+// Buffers are sized for one resolution and pixel format at a time; when
+// the format changes a new pool is started and the old one is freed once
+// its last buffer comes back. Frames can be passed between threads by
+// reference, the pool must outlive every frame it filled.
+class FramePool {
+public:
+    FramePool();
+    ~FramePool();
+
+    // Gives the frame pooled, 64-byte aligned planes
+    bool getBuffer(AVFrame* frame, int width, int height, AVPixelFormat format);
+
+    // get_buffer2 callback; the codec context's opaque must point at the pool
+    static int getCodecBuffer(AVCodecContext* context, AVFrame* frame, int flags);
+
+    // Drops the pooled buffers and starts the stats over
+    void reset();
+    FramePoolStats getStats() const;
+
+private:
+    AVBufferPool* pool;
+    int poolWidth;
+    int poolHeight;
+    AVPixelFormat poolFormat;
+    int linesizes[4];
+    size_t planeOffsets[4];
+    mutable std::mutex mutex;
+
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> misses;
+    std::atomic<int64_t> liveBytes;
+    std::atomic<int64_t> peakBytes;
+
+    bool fillFrame(AVFrame* frame, int width, int height, AVPixelFormat format);
+    static AVBufferRef* allocateBuffer(void* opaque, size_t size);
+    static void freeBuffer(void* opaque, uint8_t* data);
+};
+
+#endif // FRAMEPOOL_H
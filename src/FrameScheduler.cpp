@@ -0,0 +1,137 @@
+// FrameScheduler.cpp
+#include "FrameScheduler.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace {
+const int DEFAULT_REFRESH_RATE = 60;
+
+// Weight of the newest present interval in the refresh estimate; intervals
+// outside the band around it are missed vsyncs or stalls, not the refresh
+const double REFRESH_SMOOTHING = 0.05;
+const double REFRESH_BAND = 0.25;
+
+// Upper bounds of the pacing histogram buckets, milliseconds
+const double BUCKET_LIMITS_MS[PACING_BUCKETS - 1] = { 0.5, 1.0, 2.0, 4.0, 8.0, 16.7, 33.3 };
+}
+
+FrameScheduler::FrameScheduler()
+    : vsync(false)
+    , refreshInterval(1.0 / DEFAULT_REFRESH_RATE)
+    , lastPresent(-1.0) {
+    resetStats();
+}
+
+void FrameScheduler::init(SDL_Window* window, SDL_Renderer* renderer) {
+    SDL_RendererInfo info;
+    vsync = SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+
+    SDL_DisplayMode mode;
+    int refreshRate = DEFAULT_REFRESH_RATE;
+    if (SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0) {
+        refreshRate = mode.refresh_rate;
+    }
+
+    refreshInterval = 1.0 / refreshRate;
+    lastPresent = -1.0;
+    stats.refreshInterval = refreshInterval;
+
+    std::cout << "Display: " << refreshRate << " Hz, vsync " << (vsync ? "on" : "off") << std::endl;
+}
+
+double FrameScheduler::now() {
+    static const double frequency = (double)SDL_GetPerformanceFrequency();
+    return SDL_GetPerformanceCounter() / frequency;
+}
+
+double FrameScheduler::getPresentTime(double now) const {
+    if (!vsync || lastPresent < 0.0) {
+        return now;
+    }
+
+    // The first vsync after now, counted on from the last one seen
+    double vsyncs = std::max(1.0, std::ceil((now - lastPresent) / refreshInterval));
+    return lastPresent + vsyncs * refreshInterval;
+}
+
+double FrameScheduler::getWakeTime(double dueTime) const {
+    // Presents block until vsync, so waking one refresh early is enough to
+    // make the vsync at or right after the due time
+    return vsync ? dueTime - refreshInterval : dueTime;
+}
+
+void FrameScheduler::waitForEvents(double wakeTime) const {
+    // Rounded up; waking a little late costs less than waking early and
+    // coming straight back
+    double remaining = wakeTime - now();
+    if (remaining > 0.0) {
+        SDL_WaitEventTimeout(nullptr, (int)std::ceil(remaining * 1000.0));
+    }
+}
+
+void FrameScheduler::waitForEvents() const {
+    SDL_WaitEvent(nullptr);
+}
+
+void FrameScheduler::presented(double presentTime) {
+    stats.presents++;
+    if (!vsync) {
+        return;
+    }
+
+    if (lastPresent >= 0.0) {
+        double interval = presentTime - lastPresent;
+        if (std::fabs(interval - refreshInterval) < REFRESH_BAND * refreshInterval) {
+            refreshInterval += REFRESH_SMOOTHING * (interval - refreshInterval);
+            stats.refreshInterval = refreshInterval;
+        }
+    }
+    lastPresent = presentTime;
+}
+
+void FrameScheduler::frameShown(double dueTime, double presentTime) {
+    double error = presentTime - dueTime;
+    double errorMs = std::fabs(error) * 1000.0;
+
+    int bucket = 0;
+    while (bucket < PACING_BUCKETS - 1 && errorMs >= BUCKET_LIMITS_MS[bucket]) {
+        bucket++;
+    }
+    stats.histogram[bucket]++;
+
+    stats.framesTimed++;
+    errorSum += error;
+    stats.averageError = errorSum / stats.framesTimed;
+    stats.worstError = std::max(stats.worstError, std::fabs(error));
+}
+
+void FrameScheduler::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+    stats.refreshInterval = refreshInterval;
+    errorSum = 0.0;
+}
+
+void FrameScheduler::printStats() const {
+    if (stats.framesTimed == 0) {
+        return;
+    }
+
+    std::cout << "Frame pacing: " << stats.framesTimed << " frames over " << stats.presents
+        << " presents, refresh " << stats.refreshInterval * 1000.0 << "ms, error avg "
+        << stats.averageError * 1000.0 << "ms, worst " << stats.worstError * 1000.0 << "ms" << std::endl;
+
+    for (int i = 0; i < PACING_BUCKETS; i++) {
+        if (i < PACING_BUCKETS - 1) {
+            std::cout << "  < " << BUCKET_LIMITS_MS[i] << "ms: ";
+        }
+        else {
+            std::cout << " >= " << BUCKET_LIMITS_MS[i - 1] << "ms: ";
+        }
+
+        int width = (int)(stats.histogram[i] * 40 / stats.framesTimed);
+        std::cout << std::string(width, '#') << " " << stats.histogram[i] << std::endl;
+    }
+}
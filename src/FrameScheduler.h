@@ -0,0 +1,65 @@
+// FrameScheduler.h
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <cstdint>
+#include <SDL.h>
+
+// Presentation error buckets from under 0.5 ms to two frames and more
+const int PACING_BUCKETS = 8;
+
+struct FramePacingStats {
+    uint64_t presents;
+    uint64_t framesTimed;
+    double refreshInterval;             // Estimated, seconds
+    double averageError;                // Presented minus due, seconds
+    double worstError;
+    uint64_t histogram[PACING_BUCKETS]; // Absolute error per bucket
+};
+
+// Paces the main loop: sleeps until the next picture is due or an input
+// event arrives, predicts the vsync a present will land on and measures
+// how far presented pictures ended up from their due time. Times are
+// seconds on the high-resolution performance counter.
+class FrameScheduler {
+public:
+    FrameScheduler();
+
+    // Reads the display refresh rate and whether presents wait for vsync
+    void init(SDL_Window* window, SDL_Renderer* renderer);
+
+    static double now();
+
+    // When a present started now would reach the screen
+    double getPresentTime(double now) const;
+    // When to wake up so that a picture due at dueTime makes its vsync
+    double getWakeTime(double dueTime) const;
+
+    // Sleeps until wakeTime or until an event is pending, which is left in
+    // the queue
+    void waitForEvents(double wakeTime) const;
+    // Sleeps until an event is pending
+    void waitForEvents() const;
+
+    // Call once SDL_RenderPresent returned; refines the refresh estimate
+    void presented(double presentTime);
+    // Records a new picture that was due at dueTime reaching the screen
+    void frameShown(double dueTime, double presentTime);
+
+    double getRefreshInterval() const { return refreshInterval; }
+    bool hasVsync() const { return vsync; }
+
+    const FramePacingStats& getStats() const { return stats; }
+    void resetStats();
+    void printStats() const;
+
+private:
+    bool vsync;
+    double refreshInterval;
+    double lastPresent;     // Last vsync a present returned on, < 0 if none
+
+    double errorSum;
+    FramePacingStats stats;
+};
+
+#endif // FRAMESCHEDULER_H
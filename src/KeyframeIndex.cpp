@@ -0,0 +1,275 @@
+// KeyframeIndex.cpp
+#include "KeyframeIndex.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char SIDECAR_MAGIC[4] = { 'K', 'F', 'I', '1' };
+const uint32_t SIDECAR_VERSION = 1;
+
+// Fixed-size sidecar header; the entries follow it directly
+struct SidecarHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t fileSize;       // Size and write time of the indexed file
+    int64_t modifiedTime;
+    int32_t streamIndex;
+    int32_t timeBaseNum;
+    int32_t timeBaseDen;
+    uint32_t entrySize;
+    int64_t entryCount;
+};
+
+bool getFileStamp(const std::string& filename, int64_t& size, int64_t& modified) {
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::u8path(filename);
+    uintmax_t fileSize = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    auto writeTime = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+
+    size = (int64_t)fileSize;
+    modified = (int64_t)writeTime.time_since_epoch().count();
+    return true;
+}
+}
+
+KeyframeIndex::KeyframeIndex()
+    : streamIndex(-1)
+    , timeBase{ 0, 1 }
+    , ready(false)
+    , cancelled(false) {
+}
+
+KeyframeIndex::~KeyframeIndex() {
+    close();
+}
+
+void KeyframeIndex::open(const std::string& file, int index, AVRational streamTimeBase) {
+    close();
+
+    filename = file;
+    streamIndex = index;
+    timeBase = streamTimeBase;
+
+    if (loadSidecar()) {
+        std::cout << "Loaded keyframe index: " << entries.size() << " keyframes" << std::endl;
+        ready = true;
+        return;
+    }
+
+    cancelled = false;
+    buildThread = std::thread(&KeyframeIndex::buildIndex, this);
+}
+
+void KeyframeIndex::close() {
+    cancelled = true;
+    if (buildThread.joinable()) {
+        buildThread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    ready = false;
+    streamIndex = -1;
+}
+
+size_t KeyframeIndex::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+bool KeyframeIndex::findByPts(int64_t pts, KeyframeEntry& entry) const {
+    if (!ready) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::upper_bound(entries.begin(), entries.end(), pts,
+        [](int64_t value, const KeyframeEntry& e) { return value < e.pts; });
+    if (it == entries.begin()) {
+        return false;
+    }
+
+    entry = *(it - 1);
+    return true;
+}
+
+bool KeyframeIndex::findByFrame(int64_t frameNumber, KeyframeEntry& entry) const {
+    if (!ready) {
+        return false;
+    }
+
+    // Frame numbers grow with pts, so the pts order works for both lookups
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::upper_bound(entries.begin(), entries.end(), frameNumber,
+        [](int64_t value, const KeyframeEntry& e) { return value < e.frameNumber; });
+    if (it == entries.begin()) {
+        return false;
+    }
+
+    entry = *(it - 1);
+    return true;
+}
+
+std::string KeyframeIndex::getSidecarPath(const std::string& filename) {
+    return filename + ".kfi";
+}
+
+int KeyframeIndex::interruptCallback(void* opaque) {
+    return static_cast<KeyframeIndex*>(opaque)->cancelled ? 1 : 0;
+}
+
+void KeyframeIndex::buildIndex() {
+    // A reader of its own keeps the playback demuxer untouched
+    AVFormatContext* context = avformat_alloc_context();
+    if (!context) {
+        return;
+    }
+    context->interrupt_callback.callback = interruptCallback;
+    context->interrupt_callback.opaque = this;
+
+    if (avformat_open_input(&context, filename.c_str(), nullptr, nullptr) < 0) {
+        return; // The context is freed on failure
+    }
+
+    if (streamIndex < 0 || streamIndex >= (int)context->nb_streams) {
+        avformat_close_input(&context);
+        return;
+    }
+    for (unsigned int i = 0; i < context->nb_streams; i++) {
+        context->streams[i]->discard = (int)i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+
+    // Only packet headers are needed, nothing is decoded
+    std::vector<KeyframeEntry> keyframes;
+    std::vector<int64_t> presentationTimes;
+    AVPacket* packet = av_packet_alloc();
+
+    while (packet && !cancelled && av_read_frame(context, packet) >= 0) {
+        if (packet->stream_index == streamIndex) {
+            int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (pts != AV_NOPTS_VALUE) {
+                presentationTimes.push_back(pts);
+                if (packet->flags & AV_PKT_FLAG_KEY) {
+                    keyframes.push_back(KeyframeEntry{ pts, packet->pos, 0 });
+                }
+            }
+        }
+        av_packet_unref(packet);
+    }
+
+    av_packet_free(&packet);
+    avformat_close_input(&context);
+
+    if (cancelled) {
+        return;
+    }
+
+    // A keyframe's number is how many frames are presented before it
+    std::sort(presentationTimes.begin(), presentationTimes.end());
+    std::sort(keyframes.begin(), keyframes.end(),
+        [](const KeyframeEntry& a, const KeyframeEntry& b) { return a.pts < b.pts; });
+    for (KeyframeEntry& keyframe : keyframes) {
+        keyframe.frameNumber = std::lower_bound(presentationTimes.begin(),
+            presentationTimes.end(), keyframe.pts) - presentationTimes.begin();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries = std::move(keyframes);
+    }
+    ready = true;
+
+    std::cout << "Built keyframe index: " << entries.size() << " keyframes in "
+        << presentationTimes.size() << " frames" << std::endl;
+
+    if (!saveSidecar()) {
+        std::cerr << "Could not save keyframe index: " << getSidecarPath(filename) << std::endl;
+    }
+}
+
+bool KeyframeIndex::loadSidecar() {
+    int64_t fileSize = 0;
+    int64_t modifiedTime = 0;
+    if (!getFileStamp(filename, fileSize, modifiedTime)) {
+        return false;
+    }
+
+    std::ifstream input(std::filesystem::u8path(getSidecarPath(filename)), std::ios::binary);
+    if (!input) {
+        return false;
+    }
+
+    // Stale or foreign sidecars are rebuilt
+    SidecarHeader header;
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) != 0 ||
+        header.version != SIDECAR_VERSION ||
+        header.entrySize != sizeof(KeyframeEntry) ||
+        header.fileSize != fileSize || header.modifiedTime != modifiedTime ||
+        header.streamIndex != streamIndex ||
+        header.timeBaseNum != timeBase.num || header.timeBaseDen != timeBase.den ||
+        header.entryCount < 0 || header.entryCount > fileSize) {
+        return false;
+    }
+
+    std::vector<KeyframeEntry> loaded((size_t)header.entryCount);
+    std::streamsize bytes = (std::streamsize)(loaded.size() * sizeof(KeyframeEntry));
+    if (!input.read(reinterpret_cast<char*>(loaded.data()), bytes)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    entries = std::move(loaded);
+    return true;
+}
+
+bool KeyframeIndex::saveSidecar() const {
+    SidecarHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+    header.version = SIDECAR_VERSION;
+    header.streamIndex = streamIndex;
+    header.timeBaseNum = timeBase.num;
+    header.timeBaseDen = timeBase.den;
+    header.entrySize = sizeof(KeyframeEntry);
+    if (!getFileStamp(filename, header.fileSize, header.modifiedTime)) {
+        return false;
+    }
+
+    // Write to a temporary file first so readers never see half an index
+    std::filesystem::path path = std::filesystem::u8path(getSidecarPath(filename));
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+        if (!output) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        header.entryCount = (int64_t)entries.size();
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(entries.data()),
+            (std::streamsize)(entries.size() * sizeof(KeyframeEntry)));
+        if (!output) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+// KeyframeIndex.h
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// One keyframe of the indexed video stream
+struct KeyframeEntry {
+    int64_t pts;            // Presentation time in stream time base
+    int64_t position;       // Byte offset of the packet, -1 when unknown
+    int64_t frameNumber;    // Frames presented before this one
+};
+
+// Keyframe positions of a file's video stream. The index is built on a
+// background thread with a separate reader the first time a file is
+// opened and saved next to it as a .kfi sidecar: a fixed header followed
+// by the packed entries, so the file can be read or mapped in one go.
+class KeyframeIndex {
+public:
+    KeyframeIndex();
+    ~KeyframeIndex();
+
+    // Loads the sidecar if it is still valid, builds the index otherwise
+    void open(const std::string& filename, int streamIndex, AVRational timeBase);
+    void close();
+
+    bool isReady() const { return ready; }
+    size_t size() const;
+
+    // Last keyframe at or before the given pts or frame number
+    bool findByPts(int64_t pts, KeyframeEntry& entry) const;
+    bool findByFrame(int64_t frameNumber, KeyframeEntry& entry) const;
+
+    static std::string getSidecarPath(const std::string& filename);
+
+private:
+    std::string filename;
+    int streamIndex;
+    AVRational timeBase;
+
+    std::vector<KeyframeEntry> entries;     // Sorted by pts
+    mutable std::mutex mutex;
+
+    std::thread buildThread;
+    std::atomic<bool> ready;
+    std::atomic<bool> cancelled;
+
+    void buildIndex();
+    bool loadSidecar();
+    bool saveSidecar() const;
+    static int interruptCallback(void* opaque);
+};
+
+#endif // KEYFRAMEINDEX_H
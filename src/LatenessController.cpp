@@ -0,0 +1,93 @@
+// LatenessController.cpp
+#include "LatenessController.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Weight of the newest frame in the smoothed lateness
+const double SMOOTHING = 0.1;
+
+// Frames count as late once they are this far behind, at least
+const double MIN_LATE_SECONDS = 0.02;
+
+// How long frames must stay late before shedding more work, and on time
+// before taking some back; recovering is slower so stages do not flap
+const double ESCALATE_AFTER_SECONDS = 0.5;
+const double RECOVER_AFTER_SECONDS = 2.0;
+}
+
+LatenessController::LatenessController() {
+    memset(&stats, 0, sizeof(stats));
+    reset();
+}
+
+void LatenessController::reset() {
+    stage = LateStage::None;
+    smoothedLateness = 0.0;
+    lateSince = -1.0;
+    onTimeSince = -1.0;
+    stageChanged = -1.0;
+    stats.stage = stage;
+    stats.lateness = 0.0;
+}
+
+bool LatenessController::update(double lateness, double frameDuration, double now) {
+    stats.framesChecked++;
+    stats.framesInStage[(int)stage]++;
+    smoothedLateness += SMOOTHING * (lateness - smoothedLateness);
+
+    double lateThreshold = std::max(frameDuration, MIN_LATE_SECONDS);
+    if (smoothedLateness > lateThreshold) {
+        onTimeSince = -1.0;
+        if (lateSince < 0.0) {
+            lateSince = now;
+        }
+        if (stage < LateStage::KeyframesOnly &&
+            now - std::max(lateSince, stageChanged) >= ESCALATE_AFTER_SECONDS) {
+            setStage((LateStage)((int)stage + 1), now);
+        }
+    }
+    else if (smoothedLateness < 0.0) {
+        // Decoding is ahead of the clock again
+        lateSince = -1.0;
+        if (onTimeSince < 0.0) {
+            onTimeSince = now;
+        }
+        if (stage > LateStage::None &&
+            now - std::max(onTimeSince, stageChanged) >= RECOVER_AFTER_SECONDS) {
+            setStage((LateStage)((int)stage - 1), now);
+        }
+    }
+    else {
+        lateSince = -1.0;
+        onTimeSince = -1.0;
+    }
+
+    stats.stage = stage;
+    stats.lateness = smoothedLateness;
+
+    // A frame already past its display slot is not worth converting; with
+    // keyframes only every frame is kept so the picture still moves
+    bool drop = stage >= LateStage::DropFrames && stage < LateStage::KeyframesOnly &&
+        lateness > frameDuration;
+    if (drop) {
+        stats.framesDropped++;
+    }
+    return drop;
+}
+
+void LatenessController::setStage(LateStage newStage, double now) {
+    stage = newStage;
+    stageChanged = now;
+    stats.stageEntries[(int)stage]++;
+}
+
+const char* LatenessController::getStageName(LateStage stage) {
+    switch (stage) {
+    case LateStage::DropFrames: return "drop frames";
+    case LateStage::SkipLoopFilter: return "skip loop filter";
+    case LateStage::SkipNonRef: return "skip non-reference frames";
+    case LateStage::KeyframesOnly: return "keyframes only";
+    default: return "none";
+    }
+}
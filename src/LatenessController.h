@@ -0,0 +1,58 @@
+// LatenessController.h
+#ifndef LATENESSCONTROLLER_H
+#define LATENESSCONTROLLER_H
+
+#include <cstdint>
+
+// How much work the video decoder sheds to catch up with the clock; each
+// stage includes the ones before it
+enum class LateStage {
+    None,
+    DropFrames,         // Late frames are dropped before conversion
+    SkipLoopFilter,     // Deblocking is skipped
+    SkipNonRef,         // Frames nothing else refers to are not decoded
+    KeyframesOnly,      // Only keyframes are decoded
+    Count
+};
+
+struct LatenessStats {
+    LateStage stage;
+    double lateness;                                    // Smoothed, seconds behind the clock
+    uint64_t framesChecked;
+    uint64_t framesDropped;
+    uint64_t stageEntries[(int)LateStage::Count];       // Times each stage was entered
+    uint64_t framesInStage[(int)LateStage::Count];      // Frames decoded in each stage
+};
+
+// Watches how far decoded frames lag behind the master clock and moves
+// one stage up when they stay late, one stage down once they have been
+// on time for a while. Pure logic; the caller applies the stage to the
+// codec and supplies the time.
+class LatenessController {
+public:
+    LatenessController();
+
+    // Starts over at LateStage::None, e.g. after a seek; counters are kept
+    void reset();
+
+    // Feeds one decoded frame; lateness is clock minus pts. Returns true
+    // when the frame should be dropped.
+    bool update(double lateness, double frameDuration, double now);
+
+    LateStage getStage() const { return stage; }
+    const LatenessStats& getStats() const { return stats; }
+
+    static const char* getStageName(LateStage stage);
+
+private:
+    LateStage stage;
+    double smoothedLateness;
+    double lateSince;       // When frames started to be late, < 0 when on time
+    double onTimeSince;     // When frames started to be on time, < 0 when late
+    double stageChanged;
+    LatenessStats stats;
+
+    void setStage(LateStage newStage, double now);
+};
+
+#endif // LATENESSCONTROLLER_H
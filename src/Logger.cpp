@@ -0,0 +1,279 @@
+// Logger.cpp
+#include "Logger.h"
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/log.h>
+#include <libavutil/time.h>
+}
+
+namespace {
+// Slots are claimed in order and released once written; a message longer
+// than a slot is cut short
+const size_t SLOT_COUNT = 1024;
+const size_t SLOT_TEXT_SIZE = 240;
+
+// The writer thread sleeps this long when the ring is empty
+const int FLUSH_INTERVAL_MS = 10;
+
+// FFmpeg may log per packet on a damaged stream; past this many messages
+// in a second the rest of that second is only counted
+const int FFMPEG_MESSAGES_PER_SECOND = 20;
+
+struct LogSlot {
+    std::atomic<uint64_t> sequence;
+    LogLevel level;
+    char text[SLOT_TEXT_SIZE];
+};
+
+// Bounded multi-producer ring: a slot whose sequence equals the write
+// position is free, one past it holds a message ready to be written
+struct LogRing {
+    LogSlot slots[SLOT_COUNT];
+    std::atomic<uint64_t> head{0};
+    uint64_t tail = 0;   // Writer thread only
+    std::atomic<uint64_t> written{0};   // Tail as of the last drain
+
+    std::atomic<bool> running{false};
+    std::thread writer;
+    std::atomic<uint64_t> dropped{0};
+    uint64_t droppedReported = 0;
+
+    std::atomic<int64_t> ffmpegSecond{0};
+    std::atomic<int> ffmpegCount{0};
+    std::atomic<uint64_t> ffmpegSuppressed{0};
+    std::atomic<uint64_t> ffmpegSuppressedTotal{0};
+
+    LogRing() {
+        for (size_t i = 0; i < SLOT_COUNT; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~LogRing() {
+        Logger::stop();
+    }
+};
+
+LogRing& getRing() {
+    static LogRing ring;
+    return ring;
+}
+
+FILE* streamFor(LogLevel level) {
+    return level >= LogLevel::Warning ? stderr : stdout;
+}
+
+void writeLine(LogLevel level, const char* text) {
+    FILE* stream = streamFor(level);
+    fputs(text, stream);
+    fputc('\n', stream);
+}
+
+// Writes every message that is ready; true if there were any
+bool drain(LogRing& ring) {
+    bool wrote = false;
+    while (true) {
+        LogSlot& slot = ring.slots[ring.tail % SLOT_COUNT];
+        if (slot.sequence.load(std::memory_order_acquire) != ring.tail + 1) {
+            break;
+        }
+        writeLine(slot.level, slot.text);
+        slot.sequence.store(ring.tail + SLOT_COUNT, std::memory_order_release);
+        ring.tail++;
+        wrote = true;
+    }
+
+    uint64_t dropped = ring.dropped.load(std::memory_order_relaxed);
+    if (dropped != ring.droppedReported) {
+        fprintf(stderr, "(%llu log messages dropped, log ring full)\n",
+            (unsigned long long)(dropped - ring.droppedReported));
+        ring.droppedReported = dropped;
+        wrote = true;
+    }
+
+    if (wrote) {
+        fflush(stdout);
+    }
+    ring.written.store(ring.tail, std::memory_order_release);
+    return wrote;
+}
+
+void writerLoop(LogRing& ring) {
+    while (ring.running.load(std::memory_order_acquire)) {
+        if (!drain(ring)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+        }
+    }
+    drain(ring);
+}
+
+LogLevel levelFromFfmpeg(int level) {
+    if (level <= AV_LOG_ERROR) {
+        return LogLevel::Error;
+    }
+    if (level <= AV_LOG_WARNING) {
+        return LogLevel::Warning;
+    }
+    if (level <= AV_LOG_INFO) {
+        return LogLevel::Info;
+    }
+    return LogLevel::Debug;
+}
+}
+
+void Logger::start() {
+    LogRing& ring = getRing();
+    if (ring.running) {
+        return;
+    }
+
+    ring.running = true;
+    ring.writer = std::thread(writerLoop, std::ref(ring));
+    av_log_set_callback(ffmpegCallback);
+}
+
+void Logger::stop() {
+    LogRing& ring = getRing();
+    if (!ring.running) {
+        return;
+    }
+
+    av_log_set_callback(av_log_default_callback);
+    ring.running = false;
+    if (ring.writer.joinable()) {
+        ring.writer.join();
+    }
+    drain(ring);
+}
+
+void Logger::flush() {
+    LogRing& ring = getRing();
+
+    // Claimed slots are filled in moments, and the writer polls at least
+    // every FLUSH_INTERVAL_MS
+    uint64_t target = ring.head.load(std::memory_order_acquire);
+    while (ring.running.load(std::memory_order_acquire) &&
+        ring.written.load(std::memory_order_acquire) < target) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    fflush(stdout);
+    fflush(stderr);
+}
+
+void Logger::write(LogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    writeV(level, format, args);
+    va_end(args);
+}
+
+void Logger::writeV(LogLevel level, const char* format, va_list args) {
+    LogRing& ring = getRing();
+
+    // Without the writer thread the caller writes the line itself
+    if (!ring.running.load(std::memory_order_acquire)) {
+        char text[SLOT_TEXT_SIZE];
+        vsnprintf(text, sizeof(text), format, args);
+        writeLine(level, text);
+        fflush(streamFor(level));
+        return;
+    }
+
+    // Claim the slot at the head unless the writer has not freed it yet
+    uint64_t position = ring.head.load(std::memory_order_relaxed);
+    LogSlot* slot;
+    while (true) {
+        slot = &ring.slots[position % SLOT_COUNT];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            if (ring.head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (sequence < position) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else {
+            position = ring.head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    vsnprintf(slot->text, SLOT_TEXT_SIZE, format, args);
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+uint64_t Logger::getDroppedCount() {
+    return getRing().dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t Logger::getSuppressedCount() {
+    return getRing().ffmpegSuppressedTotal.load(std::memory_order_relaxed);
+}
+
+void Logger::ffmpegCallback(void* context, int level, const char* format, va_list args) {
+    if (level > av_log_get_level()) {
+        return;
+    }
+    LogLevel logLevel = levelFromFfmpeg(level);
+    if ((int)logLevel < MEDIAPLAYER_LOG_LEVEL) {
+        return;
+    }
+
+    // Lines arrive whole or in pieces; pieces are gathered per thread until
+    // the newline, so a line is written and counted once. The prefix goes
+    // on the first piece, and a line longer than a slot is cut short.
+    thread_local int printPrefix = 1;
+    thread_local char line[SLOT_TEXT_SIZE];
+    thread_local size_t lineLength = 0;
+    thread_local LogLevel lineLevel = LogLevel::Info;
+
+    char piece[SLOT_TEXT_SIZE];
+    av_log_format_line2(context, level, format, args, piece, sizeof(piece), &printPrefix);
+    size_t pieceLength = strlen(piece);
+    if (lineLength == 0) {
+        lineLevel = logLevel;
+    }
+    size_t copied = std::min(pieceLength, SLOT_TEXT_SIZE - 1 - lineLength);
+    memcpy(line + lineLength, piece, copied);
+    lineLength += copied;
+    line[lineLength] = '\0';
+    if (pieceLength == 0 || piece[pieceLength - 1] != '\n') {
+        return;
+    }
+
+    while (lineLength > 0 && (line[lineLength - 1] == '\n' || line[lineLength - 1] == '\r')) {
+        line[--lineLength] = '\0';
+    }
+    bool empty = lineLength == 0;
+    lineLength = 0;
+    if (empty) {
+        return;
+    }
+
+    // A new second reopens the budget and reports what the last one held back
+    LogRing& ring = getRing();
+    int64_t second = av_gettime_relative() / 1000000;
+    int64_t current = ring.ffmpegSecond.load(std::memory_order_relaxed);
+    if (second != current && ring.ffmpegSecond.compare_exchange_strong(current, second)) {
+        ring.ffmpegCount = 0;
+        uint64_t suppressed = ring.ffmpegSuppressed.exchange(0);
+        if (suppressed > 0) {
+            write(LogLevel::Warning, "(%llu FFmpeg messages suppressed)", (unsigned long long)suppressed);
+        }
+    }
+    if (ring.ffmpegCount.fetch_add(1, std::memory_order_relaxed) >= FFMPEG_MESSAGES_PER_SECOND) {
+        ring.ffmpegSuppressed.fetch_add(1, std::memory_order_relaxed);
+        ring.ffmpegSuppressedTotal.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    write(lineLevel, "%s", line);
+}
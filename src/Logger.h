@@ -0,0 +1,66 @@
+// Logger.h
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <cstdint>
+#include <cstdarg>
+
+// Messages below this level are compiled out: 0 debug, 1 info, 2 warning,
+// 3 error. Set with -DMEDIAPLAYER_LOG_LEVEL=n; a disabled LOG_ macro is a
+// constant false branch and costs nothing, its arguments are not evaluated.
+#ifndef MEDIAPLAYER_LOG_LEVEL
+#define MEDIAPLAYER_LOG_LEVEL 1
+#endif
+
+enum class LogLevel {
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LOG_PRINTF_FORMAT(formatIndex, argIndex) __attribute__((format(printf, formatIndex, argIndex)))
+#else
+#define LOG_PRINTF_FORMAT(formatIndex, argIndex)
+#endif
+
+// Formats messages printf-style straight into a fixed ring of slots and
+// returns; a background thread writes them out in batches with one flush
+// each, debug and info to stdout, warnings and errors to stderr. Producers
+// never lock or wait: when the ring is full the message is dropped and
+// counted. Before start() and after stop() messages are written directly.
+class Logger {
+public:
+    // Starts the writer thread and routes av_log through the logger
+    static void start();
+    // Writes out everything queued and goes back to direct output
+    static void stop();
+    // Waits until every message logged before the call has been written,
+    // so output printed next cannot land in the middle of the backlog
+    static void flush();
+
+    static void write(LogLevel level, const char* format, ...) LOG_PRINTF_FORMAT(2, 3);
+    static void writeV(LogLevel level, const char* format, va_list args);
+
+    // Messages lost to a full ring, and FFmpeg messages over the rate limit
+    static uint64_t getDroppedCount();
+    static uint64_t getSuppressedCount();
+
+private:
+    static void ffmpegCallback(void* context, int level, const char* format, va_list args);
+};
+
+#define LOG_AT(level, minimum, ...) \
+    do { \
+        if (MEDIAPLAYER_LOG_LEVEL <= (minimum)) { \
+            Logger::write(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, 0, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, 1, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(LogLevel::Warning, 2, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, 3, __VA_ARGS__)
+
+#endif // LOGGER_H
@@ -0,0 +1,142 @@
+// MediaOpener.cpp
+#include "MediaOpener.h"
+#include <iostream>
+#include <chrono>
+
+MediaOpener::MediaOpener()
+    : busy(false)
+    , cancelled(false)
+    , pendingDemuxer(nullptr)
+    , resultReady(false) {
+}
+
+MediaOpener::~MediaOpener() {
+    cancel();
+}
+
+bool MediaOpener::start(const std::string& file, const DemuxerOptions& demuxerOptions,
+    const DecoderOptions& decoders) {
+    // Only the newest request matters
+    cancel();
+
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        result = OpenedMedia();
+        resultReady = false;
+    }
+
+    filename = file;
+    options = demuxerOptions;
+    decoderOptions = decoders;
+    cancelled = false;
+    busy = true;
+    workerThread = std::thread(&MediaOpener::run, this);
+    return true;
+}
+
+void MediaOpener::cancel() {
+    cancelled = true;
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        if (pendingDemuxer) {
+            pendingDemuxer->interrupt();
+        }
+    }
+    wait();
+}
+
+void MediaOpener::wait() {
+    if (workerThread.joinable()) {
+        workerThread.join();
+    }
+}
+
+bool MediaOpener::takeResult(OpenedMedia& media) {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    if (!resultReady) {
+        return false;
+    }
+
+    media = std::move(result);
+    result = OpenedMedia();
+    resultReady = false;
+    return true;
+}
+
+void MediaOpener::run() {
+    auto startTime = std::chrono::steady_clock::now();
+
+    OpenedMedia media;
+    media.filename = filename;
+    media.demuxer = std::make_unique<Demuxer>();
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        pendingDemuxer = media.demuxer.get();
+    }
+
+    report(OpenStage::Opening);
+    if (cancelled || !media.demuxer->openFile(filename, options)) {
+        finish(cancelled ? OpenStage::Cancelled : OpenStage::Failed, media);
+        return;
+    }
+
+    // Codec setup is quick, so it is only checked for cancellation after
+    report(OpenStage::OpeningDecoders);
+    media.videoDecoder = std::make_unique<VideoDecoder>();
+    media.audioDecoder = std::make_unique<AudioDecoder>();
+    media.videoDecoder->setThreadingPolicy(decoderOptions.threadingPolicy, decoderOptions.videoThreads);
+    media.videoDecoder->setBitexact(decoderOptions.bitexact);
+    media.videoDecoder->setSimdConversion(decoderOptions.simdConversion);
+    media.audioDecoder->setBitexact(decoderOptions.bitexact);
+    media.audioDecoder->setLatency(decoderOptions.audioLatency);
+    media.hasVideo = media.videoDecoder->OpenStream(*media.demuxer);
+    media.hasAudio = media.audioDecoder->openStream(*media.demuxer);
+
+    if (cancelled) {
+        finish(OpenStage::Cancelled, media);
+        return;
+    }
+    if (!media.hasVideo && !media.hasAudio) {
+        finish(OpenStage::Failed, media);
+        return;
+    }
+
+    media.openSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    finish(OpenStage::Ready, media);
+}
+
+void MediaOpener::finish(OpenStage stage, OpenedMedia& media) {
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        pendingDemuxer = nullptr;
+        if (stage == OpenStage::Ready) {
+            result = std::move(media);
+            resultReady = true;
+        }
+    }
+
+    // Anything not handed over is closed here, decoders before the demuxer
+    media.videoDecoder.reset();
+    media.audioDecoder.reset();
+    media.demuxer.reset();
+
+    busy = false;
+    report(stage);
+}
+
+void MediaOpener::report(OpenStage stage) {
+    if (progressCallback) {
+        progressCallback(stage, filename);
+    }
+}
+
+const char* MediaOpener::getStageName(OpenStage stage) {
+    switch (stage) {
+    case OpenStage::Opening: return "opening";
+    case OpenStage::OpeningDecoders: return "opening decoders";
+    case OpenStage::Ready: return "ready";
+    case OpenStage::Failed: return "failed";
+    case OpenStage::Cancelled: return "cancelled";
+    default: return "unknown";
+    }
+}
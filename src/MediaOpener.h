@@ -0,0 +1,93 @@
+// MediaOpener.h
+#ifndef MEDIAOPENER_H
+#define MEDIAOPENER_H
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "Demuxer.h"
+#include "VideoDecoder.h"
+#include "AudioDecoder.h"
+
+enum class OpenStage {
+    Opening,            // Reading the container and probing its streams
+    OpeningDecoders,
+    Ready,              // The result can be taken
+    Failed,
+    Cancelled
+};
+
+// Decoder settings applied before the streams are opened
+struct DecoderOptions {
+    int videoThreads = 0;   // 0 leaves the count to the threading policy
+    ThreadingPolicy threadingPolicy = ThreadingPolicy::Auto;
+    bool bitexact = false;  // Reproducible output for checksum runs
+    bool simdConversion = true;
+    AudioLatency audioLatency = AudioLatency::High;
+};
+
+// A file opened off the main thread, with decoders attached and the demux
+// thread not started yet. Decoders are declared after the demuxer so they
+// are destroyed first.
+struct OpenedMedia {
+    std::string filename;
+    std::unique_ptr<Demuxer> demuxer;
+    std::unique_ptr<VideoDecoder> videoDecoder;
+    std::unique_ptr<AudioDecoder> audioDecoder;
+    bool hasVideo = false;
+    bool hasAudio = false;
+    double openSeconds = 0.0;
+};
+
+// Opens media on a worker thread so the window stays responsive, while
+// whatever is playing carries on. The caller swaps the result in once it
+// is ready. A new start() or cancel() interrupts a pending open, including
+// blocking container reads.
+class MediaOpener {
+public:
+    // Called on the worker thread whenever the stage changes
+    typedef std::function<void(OpenStage stage, const std::string& filename)> ProgressCallback;
+
+    MediaOpener();
+    ~MediaOpener();
+
+    void setProgressCallback(ProgressCallback callback) { progressCallback = callback; }
+
+    bool start(const std::string& filename, const DemuxerOptions& options,
+        const DecoderOptions& decoderOptions = DecoderOptions());
+    void cancel();
+    void wait();
+    bool isBusy() const { return busy; }
+
+    // Hands over a finished open once; false while busy or after a failure
+    bool takeResult(OpenedMedia& media);
+
+    static const char* getStageName(OpenStage stage);
+
+private:
+    std::string filename;
+    DemuxerOptions options;
+    DecoderOptions decoderOptions;
+    ProgressCallback progressCallback;
+
+    std::thread workerThread;
+    std::atomic<bool> busy;
+    std::atomic<bool> cancelled;
+
+    // The demuxer being opened, interrupted on cancel; the result waits
+    // here until taken
+    std::mutex resultMutex;
+    Demuxer* pendingDemuxer;
+    OpenedMedia result;
+    bool resultReady;
+
+    void run();
+    void finish(OpenStage stage, OpenedMedia& media);
+    void report(OpenStage stage);
+};
+
+#endif // MEDIAOPENER_H
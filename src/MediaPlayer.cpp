@@ -1,23 +1,83 @@
 // Updated MediaPlayer.cpp with audio support
 #include "MediaPlayer.h"
+#include "ProcessStats.h"
+#include "Tracer.h"
+#include "Logger.h"
 #include <iostream>
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+
+namespace {
+// Probing limits in fast start mode unless set explicitly: enough for the
+// usual containers, far below FFmpeg's 5 MB / 5 s defaults
+const int64_t FAST_START_PROBE_SIZE = 1024 * 1024;
+const int64_t FAST_START_ANALYZE_DURATION = 1000000;
+
+// Headless audio goes to SDL's disk driver, which plays in real time
+#ifdef _WIN32
+const char* NULL_DEVICE = "NUL";
+#else
+const char* NULL_DEVICE = "/dev/null";
+#endif
+
+std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+}
 
 MediaPlayer::MediaPlayer()
     : window(nullptr)
     , sdlRenderer(nullptr)
+    , openEventType((Uint32)-1)
     , running(false)
     , playing(false)
     , muted(false)
     , volume(1.0f)
     , videoTexture(nullptr)
+    , videoTextureFormat(SDL_PIXELFORMAT_UNKNOWN)
     , hasVideo(false)
-    , hasAudio(false) {
-
-    // Initialize decoders
+    , hasAudio(false)
+    , hasVideoFrame(false)
+    , videoTextureWidth(0)
+    , videoTextureHeight(0)
+    , shownFrameDue(-1.0)
+    , shownFramePts(0.0)
+    , shownFrameSequence(0)
+    , needsRedraw(true)
+    , idleStartTime(-1.0)
+    , idleStartCpu(0.0)
+    , idleWakeups(0)
+    , idleRedraws(0)
+    , hudSampleTime(0.0)
+    , hudSampleFrames(0)
+    , decodeFps(0.0)
+    , uploadMs(0.0)
+    , hudMs(0.0)
+    , fastStart(false)
+    , audioStarting(false)
+    , runStats()
+    , runStartTime(-1.0)
+    , nextSeekTime(0.0)
+    , seekStartTime(-1.0)
+    , seekRandom(1)
+    , allocationStartTime(-1.0)
+    , allocationStartPoolMisses(0) {
+
+    // Initialize demuxer and decoders
+    demuxer = std::make_unique<Demuxer>();
     videoDecoder = std::make_unique<VideoDecoder>();
     audioDecoder = std::make_unique<AudioDecoder>();
+    thumbnailEngine = std::make_unique<ThumbnailEngine>();
 }
 
 MediaPlayer::~MediaPlayer() {
@@ -26,6 +86,7 @@ MediaPlayer::~MediaPlayer() {
 
 bool MediaPlayer::initialize() {
     std::cout << "Initializing Media Player..." << std::endl;
+    startupProfiler.begin("initialize");
 
     if (!initializeSDL()) {
         std::cerr << "Failed to initialize SDL" << std::endl;
@@ -36,17 +97,27 @@ bool MediaPlayer::initialize() {
         std::cerr << "Failed to initialize FFmpeg" << std::endl;
         return false;
     }
+    startupProfiler.mark("FFmpeg ready");
 
     std::cout << "Media Player initialized successfully!" << std::endl;
+    startupProfiler.report();
     return true;
 }
 
 bool MediaPlayer::initializeSDL() {
+    // Without a display, render off screen and write audio nowhere
+    if (runOptions.headless) {
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+        SDL_setenv("SDL_AUDIODRIVER", "disk", 1);
+        SDL_setenv("SDL_DISKAUDIOFILE", NULL_DEVICE, 1);
+    }
+
     // Initialize SDL with audio support
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) < 0) {
         std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << std::endl;
         return false;
     }
+    startupProfiler.mark("SDL initialized");
 
     // Create window
     window = SDL_CreateWindow(
@@ -55,20 +126,41 @@ bool MediaPlayer::initializeSDL() {
         SDL_WINDOWPOS_CENTERED,
         WINDOW_WIDTH,
         WINDOW_HEIGHT,
-        SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE
+        (runOptions.headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN) | SDL_WINDOW_RESIZABLE
     );
 
     if (!window) {
         std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError() << std::endl;
         return false;
     }
+    startupProfiler.mark("window created");
 
-    // Create renderer
-    sdlRenderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    // Create renderer; benchmarks present as fast as pictures arrive
+    Uint32 rendererFlags = runOptions.headless ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED;
+    if (!runOptions.bench) {
+        rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    sdlRenderer = SDL_CreateRenderer(window, -1, rendererFlags);
     if (!sdlRenderer) {
         std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
         return false;
     }
+    startupProfiler.mark("renderer created");
+
+    frameScheduler.init(window, sdlRenderer);
+
+    // Background opens report through the event queue, which also wakes
+    // an idle main loop
+    openEventType = SDL_RegisterEvents(1);
+    mediaOpener.setProgressCallback([this](OpenStage stage, const std::string&) {
+        startupProfiler.mark(MediaOpener::getStageName(stage));
+
+        SDL_Event event;
+        SDL_zero(event);
+        event.type = openEventType;
+        event.user.code = (Sint32)stage;
+        SDL_PushEvent(&event);
+    });
 
     // Set renderer color (black background)
     SDL_SetRenderDrawColor(sdlRenderer, 0, 0, 0, 255);
@@ -94,21 +186,129 @@ void MediaPlayer::run() {
     std::cout << "  M - Mute/Unmute" << std::endl;
     std::cout << "  +/- - Volume Up/Down" << std::endl;
     std::cout << "  LEFT/RIGHT - Seek -/+ 10 seconds" << std::endl;
+    std::cout << "  T - Save contact sheet" << std::endl;
+    std::cout << "  C - Cycle sync master (audio/video/external)" << std::endl;
+    std::cout << "  H - Toggle performance overlay" << std::endl;
     std::cout << "  ESC - Exit" << std::endl;
 
+    frameScheduler.resetStats();
+    TRACE_THREAD_NAME("main");
+
     while (running) {
         handleEvents();
-        render();
+        syncAudioVideo();
+
+        updateStartupProfile();
+        updateRun();
+        if (playing && hasAudio && runOptions.bench) {
+            pullBenchAudio();
+        }
+
+        shownFrameDue = -1.0;
+        if (playing && hasVideo) {
+            updateVideoFrame();
+        }
+        else if (playing && hasAudio && !runOptions.bench) {
+            // The visualization animates with the audio clock
+            invalidate();
+        }
+
+        // Draw only when something on screen changed
+        if (needsRedraw) {
+            TRACE_SCOPE_PICTURE("present", shownFrameDue >= 0.0 ? shownFrameSequence : 0, shownFramePts);
+            render();
+            needsRedraw = false;
+
+            double presented = FrameScheduler::now();
+            frameScheduler.presented(presented);
+            if (shownFrameDue >= 0.0) {
+                frameScheduler.frameShown(shownFrameDue, presented);
+                if (startupProfiler.isActive() && !startupProfiler.hasMark("first picture shown")) {
+                    startupProfiler.mark("first picture shown");
+                }
+            }
+            if (idleStartTime >= 0.0) {
+                idleRedraws++;
+            }
+        }
 
         if (playing) {
-            syncAudioVideo();
+            // Sleep until the next picture is due or input arrives
+            frameScheduler.waitForEvents(getNextWakeTime());
         }
+        else {
+            // Nothing changes on its own; block until input
+            if (idleStartTime < 0.0) {
+                beginIdle();
+            }
+            frameScheduler.waitForEvents();
+            idleWakeups++;
+        }
+    }
 
-        // Control frame rate
-        SDL_Delay(16); // ~60 FPS
+    endIdle();
+    if (runOptions.allocationCheck) {
+        finishAllocationCheck();
+    }
+    if (runOptions.summary) {
+        printRunSummary();
     }
 }
 
+double MediaPlayer::getNextWakeTime() const {
+    double now = FrameScheduler::now();
+    double wake = now + MAX_WAIT_SECONDS;
+
+    if (playing && runOptions.bench) {
+        // Only wait while the decoders have nothing ready
+        bool ready = (hasVideo && videoDecoder->peekPicture()) || (hasAudio && audioDecoder->getRingFill() > 0.0);
+        return ready ? now : now + BENCH_WAIT_SECONDS;
+    }
+
+    if (playing && hasVideo) {
+        if (videoDecoder->peekPicture()) {
+            // The queued picture is due at the deadline the last decision set
+            wake = frameScheduler.getWakeTime(syncEngine.getFrameDeadline());
+        }
+        else {
+            // The decoder is behind; look again after one refresh
+            wake = now + frameScheduler.getRefreshInterval();
+        }
+    }
+    else if (playing && hasAudio) {
+        // Audio visualization follows the display
+        wake = now + frameScheduler.getRefreshInterval();
+    }
+
+    return std::min(wake, now + MAX_WAIT_SECONDS);
+}
+
+void MediaPlayer::invalidate() {
+    needsRedraw = true;
+}
+
+void MediaPlayer::beginIdle() {
+    idleStartTime = FrameScheduler::now();
+    idleStartCpu = getProcessCpuTime();
+    idleWakeups = 0;
+    idleRedraws = 0;
+}
+
+void MediaPlayer::endIdle() {
+    if (idleStartTime < 0.0) {
+        return;
+    }
+
+    // Short pauses say little about the idle cost
+    double elapsed = FrameScheduler::now() - idleStartTime;
+    if (elapsed >= MIN_IDLE_REPORT_SECONDS) {
+        double cpu = getProcessCpuTime() - idleStartCpu;
+        std::cout << "Idle for " << elapsed << "s: CPU " << cpu / elapsed * 100.0 << "%, "
+            << idleWakeups << " wakeups, " << idleRedraws << " redraws" << std::endl;
+    }
+    idleStartTime = -1.0;
+}
+
 void MediaPlayer::handleEvents() {
     SDL_Event event;
 
@@ -171,6 +371,22 @@ void MediaPlayer::handleEvents() {
                 setVolume(std::max(0.0f, volume - 0.1f));
                 break;
 
+            case SDLK_t:
+                // Write thumbnails of the open file in the background
+                generateContactSheet();
+                break;
+
+            case SDLK_c:
+                // Switch which clock the others follow
+                cycleSyncMaster();
+                break;
+
+            case SDLK_h:
+                // Show or hide the performance overlay
+                hud.toggle();
+                invalidate();
+                break;
+
             case SDLK_LEFT:
                 // Seek backward 10 seconds
                 if (hasVideo || hasAudio) {
@@ -192,7 +408,22 @@ void MediaPlayer::handleEvents() {
 
         case SDL_WINDOWEVENT:
             if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
-                std::cout << "Window resized to " << event.window.data1 << "x" << event.window.data2 << std::endl;
+                LOG_DEBUG("Window resized to %dx%d", event.window.data1, event.window.data2);
+                updateVideoOutputSize();
+            }
+
+            // The back buffer is lost on resize, expose or restore
+            if (event.window.event == SDL_WINDOWEVENT_RESIZED ||
+                event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED ||
+                event.window.event == SDL_WINDOWEVENT_EXPOSED ||
+                event.window.event == SDL_WINDOWEVENT_RESTORED) {
+                invalidate();
+            }
+            break;
+
+        default:
+            if (event.type == openEventType) {
+                handleOpenProgress((OpenStage)event.user.code);
             }
             break;
         }
@@ -229,43 +460,184 @@ void MediaPlayer::render() {
     SDL_RenderPresent(sdlRenderer);
 }
 
+void MediaPlayer::updateVideoFrame() {
+    // Benchmarks show every picture the moment it is decoded
+    if (runOptions.bench) {
+        const VideoPicture* picture = videoDecoder->peekPicture();
+        if (picture) {
+            shownFramePts = picture->pts;
+            shownFrameSequence = picture->sequence;
+            if (videoSink) {
+                videoSink->writePicture(picture->frame, picture->pts);
+            }
+            else {
+                hasVideoFrame = true;
+                uploadVideoPicture(picture);
+                invalidate();
+            }
+            videoDecoder->popPicture();
+            countShownPicture();
+        }
+        return;
+    }
+
+    // Decide for the vsync the next present lands on
+    double now = frameScheduler.getPresentTime(getMonotonicTime());
+
+    // Let the sync engine show, hold or drop the queued pictures
+    const VideoPicture* picture;
+    while ((picture = videoDecoder->peekPicture())) {
+        const VideoPicture* next = videoDecoder->peekNextPicture();
+        FrameAction action = syncEngine.decide(picture->pts, picture->duration,
+            next ? next->pts : -1.0, now);
+
+        if (action == FrameAction::Wait) {
+            break;
+        }
+        if (action == FrameAction::Show) {
+            shownFrameDue = syncEngine.getFrameDeadline();
+            shownFramePts = picture->pts;
+            shownFrameSequence = picture->sequence;
+            hasVideoFrame = true;
+            Uint64 uploadStarted = SDL_GetPerformanceCounter();
+            uploadVideoPicture(picture);
+            double elapsed = (SDL_GetPerformanceCounter() - uploadStarted) * 1000.0 / SDL_GetPerformanceFrequency();
+            uploadMs += 0.1 * (elapsed - uploadMs);
+            videoDecoder->popPicture();
+            countShownPicture();
+            invalidate();
+            break;
+        }
+        videoDecoder->popPicture();
+    }
+}
+
 void MediaPlayer::renderVideoFrame() {
-    if (!hasVideo || !playing) {
+    // Keep showing the last picture while paused or waiting for the next one
+    if (!hasVideo || !hasVideoFrame) {
         return;
     }
 
-    uint8_t* rgbData;
-    int width, height;
+    // Render video frame
+    SDL_Rect displayRect = calculateDisplayRect();
+    SDL_RenderCopy(sdlRenderer, videoTexture, nullptr, &displayRect);
+}
+
+SDL_Rect MediaPlayer::calculateDisplayRect() const {
+    // Calculate display rectangle (maintain aspect ratio)
+    int windowWidth, windowHeight;
+    SDL_GetWindowSize(window, &windowWidth, &windowHeight);
+
+    float videoAspect = (float)videoDecoder->getWidth() / videoDecoder->getHeight();
+    float windowAspect = (float)windowWidth / windowHeight;
+
+    SDL_Rect displayRect;
+    if (videoAspect > windowAspect) {
+        // Video is wider than window
+        displayRect.w = windowWidth;
+        displayRect.h = (int)(windowWidth / videoAspect);
+        displayRect.x = 0;
+        displayRect.y = (windowHeight - displayRect.h) / 2;
+    }
+    else {
+        // Video is taller than window
+        displayRect.w = (int)(windowHeight * videoAspect);
+        displayRect.h = windowHeight;
+        displayRect.x = (windowWidth - displayRect.w) / 2;
+        displayRect.y = 0;
+    }
+
+    return displayRect;
+}
 
-    if (videoDecoder->getNextFrame(&rgbData, width, height)) {
-        // Update texture with new frame data
-        SDL_UpdateTexture(videoTexture, nullptr, rgbData, width * 3);
+void MediaPlayer::updateVideoOutputSize() {
+    // Sinks take pictures at their decoded size
+    if (!hasVideo || videoSink) {
+        return;
+    }
 
-        // Calculate display rectangle (maintain aspect ratio)
-        int windowWidth, windowHeight;
-        SDL_GetWindowSize(window, &windowWidth, &windowHeight);
+    // Have the decoder produce pictures at the size they are shown
+    SDL_Rect displayRect = calculateDisplayRect();
+    videoDecoder->setOutputSize(displayRect.w, displayRect.h);
+}
 
-        float videoAspect = (float)width / height;
-        float windowAspect = (float)windowWidth / windowHeight;
+bool MediaPlayer::createVideoTexture(int width, int height) {
+    // Match the texture to what the decoder hands over
+    switch (videoDecoder->getOutputFormat()) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+        videoTextureFormat = SDL_PIXELFORMAT_IYUV;
+        break;
+    case AV_PIX_FMT_NV12:
+        videoTextureFormat = SDL_PIXELFORMAT_NV12;
+        break;
+    case AV_PIX_FMT_NV21:
+        videoTextureFormat = SDL_PIXELFORMAT_NV21;
+        break;
+    default:
+        videoTextureFormat = SDL_PIXELFORMAT_RGB24;
+        break;
+    }
 
-        SDL_Rect displayRect;
-        if (videoAspect > windowAspect) {
-            // Video is wider than window
-            displayRect.w = windowWidth;
-            displayRect.h = (int)(windowWidth / videoAspect);
-            displayRect.x = 0;
-            displayRect.y = (windowHeight - displayRect.h) / 2;
+    // Tell SDL which YUV matrix the stream uses
+    if (videoTextureFormat != SDL_PIXELFORMAT_RGB24) {
+        SDL_YUV_CONVERSION_MODE mode = SDL_YUV_CONVERSION_AUTOMATIC;
+        if (videoDecoder->isFullRange()) {
+            mode = SDL_YUV_CONVERSION_JPEG;
         }
-        else {
-            // Video is taller than window
-            displayRect.w = (int)(windowHeight * videoAspect);
-            displayRect.h = windowHeight;
-            displayRect.x = (windowWidth - displayRect.w) / 2;
-            displayRect.y = 0;
+        else if (videoDecoder->getColorSpace() == AVCOL_SPC_BT709) {
+            mode = SDL_YUV_CONVERSION_BT709;
+        }
+        else if (videoDecoder->getColorSpace() == AVCOL_SPC_BT470BG ||
+            videoDecoder->getColorSpace() == AVCOL_SPC_SMPTE170M) {
+            mode = SDL_YUV_CONVERSION_BT601;
         }
+        SDL_SetYUVConversionMode(mode);
+    }
+
+    videoTexture = SDL_CreateTexture(
+        sdlRenderer,
+        videoTextureFormat,
+        SDL_TEXTUREACCESS_STREAMING,
+        width,
+        height
+    );
+
+    videoTextureWidth = width;
+    videoTextureHeight = height;
+    return videoTexture != nullptr;
+}
+
+void MediaPlayer::uploadVideoPicture(const VideoPicture* picture) {
+    TRACE_SCOPE_PICTURE("upload", picture->sequence, picture->pts);
+    const AVFrame* frame = picture->frame;
+
+    // Pictures follow the display size, so the texture follows them
+    if (picture->width != videoTextureWidth || picture->height != videoTextureHeight) {
+        SDL_DestroyTexture(videoTexture);
+        if (!createVideoTexture(picture->width, picture->height)) {
+            std::cerr << "Failed to resize video texture: " << SDL_GetError() << std::endl;
+            hasVideoFrame = false;
+            return;
+        }
+    }
 
-        // Render video frame
-        SDL_RenderCopy(sdlRenderer, videoTexture, nullptr, &displayRect);
+    switch (videoTextureFormat) {
+    case SDL_PIXELFORMAT_IYUV:
+        SDL_UpdateYUVTexture(videoTexture, nullptr,
+            frame->data[0], frame->linesize[0],
+            frame->data[1], frame->linesize[1],
+            frame->data[2], frame->linesize[2]);
+        break;
+    case SDL_PIXELFORMAT_NV12:
+    case SDL_PIXELFORMAT_NV21:
+        SDL_UpdateNVTexture(videoTexture, nullptr,
+            frame->data[0], frame->linesize[0],
+            frame->data[1], frame->linesize[1]);
+        break;
+    default:
+        SDL_UpdateTexture(videoTexture, nullptr, frame->data[0], frame->linesize[0]);
+        break;
     }
 }
 
@@ -286,25 +658,26 @@ void MediaPlayer::renderAudioVisualization() {
     // Draw simple audio visualization bars
     if (playing) {
         SDL_SetRenderDrawColor(sdlRenderer, 0, 255, 0, 255);
-        int barWidth = 20;
-        int barSpacing = 5;
-        int numBars = 10;
+        const int barWidth = 20;
+        const int barSpacing = 5;
+        const int numBars = 10;
         int totalWidth = numBars * barWidth + (numBars - 1) * barSpacing;
         int startX = (windowWidth - totalWidth) / 2;
         int baseY = windowHeight / 2 + 50;
 
-        // Create animated bars based on time
+        // Create animated bars based on time, drawn in one batch
+        SDL_Rect bars[numBars];
         double currentTime = getCurrentTime();
         for (int i = 0; i < numBars; i++) {
             int barHeight = (int)(50 + 30 * sin(currentTime * 2 + i * 0.5));
-            SDL_Rect barRect = {
+            bars[i] = {
                 startX + i * (barWidth + barSpacing),
                 baseY - barHeight,
                 barWidth,
                 barHeight
             };
-            SDL_RenderFillRect(sdlRenderer, &barRect);
         }
+        SDL_RenderFillRects(sdlRenderer, bars, numBars);
     }
 
     // Draw audio file indicator
@@ -326,10 +699,11 @@ void MediaPlayer::renderControls() {
     SDL_SetRenderDrawColor(sdlRenderer, 255, 255, 255, 255);
     if (playing) {
         // Draw pause symbol (two bars)
-        SDL_Rect bar1 = { 20, windowHeight - 45, 8, 30 };
-        SDL_Rect bar2 = { 32, windowHeight - 45, 8, 30 };
-        SDL_RenderFillRect(sdlRenderer, &bar1);
-        SDL_RenderFillRect(sdlRenderer, &bar2);
+        SDL_Rect bars[2] = {
+            { 20, windowHeight - 45, 8, 30 },
+            { 32, windowHeight - 45, 8, 30 }
+        };
+        SDL_RenderFillRects(sdlRenderer, bars, 2);
     }
     else {
         // Draw play symbol (triangle)
@@ -377,10 +751,105 @@ void MediaPlayer::renderControls() {
             SDL_RenderFillRect(sdlRenderer, &progressFill);
         }
     }
+
+    if (hud.isVisible()) {
+        renderHud();
+    }
+}
+
+void MediaPlayer::renderHud() {
+    Uint64 started = SDL_GetPerformanceCounter();
+    double now = getMonotonicTime();
+
+    // Decode rate over the last sample window
+    VideoDecodeStats decode = {};
+    if (hasVideo) {
+        decode = videoDecoder->getDecodeStats();
+    }
+    if (decode.framesDecoded < hudSampleFrames) {
+        hudSampleFrames = 0;
+    }
+    if (now - hudSampleTime >= HUD_SAMPLE_SECONDS) {
+        decodeFps = hudSampleTime > 0.0 ? (decode.framesDecoded - hudSampleFrames) / (now - hudSampleTime) : 0.0;
+        hudSampleTime = now;
+        hudSampleFrames = decode.framesDecoded;
+    }
+
+    LatenessStats lateness = {};
+    if (hasVideo) {
+        lateness = videoDecoder->getLatenessStats();
+    }
+    AudioLatencyStats audioLatency = {};
+    double ringFill = 0.0;
+    if (hasAudio) {
+        audioLatency = audioDecoder->getLatencyStats();
+        ringFill = audioDecoder->getRingFill();
+    }
+    const SyncStats& sync = syncEngine.getStats();
+
+    // Lines keep their buffers, so steady state formatting does not allocate
+    char buffer[96];
+    hudLines.resize(6);
+    snprintf(buffer, sizeof(buffer), "DECODE %.1f FPS  CONVERT %.2f MS  UPLOAD %.2f MS",
+        decodeFps, decode.conversionMs, uploadMs);
+    hudLines[0].assign(buffer);
+    snprintf(buffer, sizeof(buffer), "PACKETS V %d A %d  PICTURES %d",
+        (int)demuxer->getQueuedPackets(AVMEDIA_TYPE_VIDEO), (int)demuxer->getQueuedPackets(AVMEDIA_TYPE_AUDIO),
+        hasVideo ? videoDecoder->getQueuedPictures() : 0);
+    hudLines[1].assign(buffer);
+    snprintf(buffer, sizeof(buffer), "AUDIO RING %.0f%%  BUFFER %d (%.1f MS)  UNDERRUNS %llu",
+        ringFill * 100.0, audioLatency.bufferFrames, audioLatency.latencyMs,
+        (unsigned long long)audioLatency.underruns);
+    hudLines[2].assign(buffer);
+    snprintf(buffer, sizeof(buffer), "SYNC %s  DRIFT %+.1f MS  MAX %.1f MS",
+        SyncEngine::getMasterName(syncEngine.getEffectiveMaster()), sync.drift * 1000.0, sync.maxDrift * 1000.0);
+    hudLines[3].assign(buffer);
+    snprintf(buffer, sizeof(buffer), "DROPPED %llu  LATE %llu  STAGE %s",
+        (unsigned long long)sync.framesDropped, (unsigned long long)lateness.framesDropped,
+        LatenessController::getStageName(lateness.stage));
+    hudLines[4].assign(buffer);
+    snprintf(buffer, sizeof(buffer), "HUD %.3f MS", hudMs);
+    hudLines[5].assign(buffer);
+
+    hud.draw(sdlRenderer, 10, 10, hudLines);
+    hudMs = (SDL_GetPerformanceCounter() - started) * 1000.0 / SDL_GetPerformanceFrequency();
 }
 
 bool MediaPlayer::loadMediaFile(const std::string& filename) {
     std::cout << "Loading media file: " << filename << std::endl;
+    startupProfiler.begin("open " + filename);
+
+    DemuxerOptions options = openOptions;
+    if (fastStart) {
+        if (options.probeSize <= 0) {
+            options.probeSize = FAST_START_PROBE_SIZE;
+        }
+        if (options.analyzeDuration <= 0) {
+            options.analyzeDuration = FAST_START_ANALYZE_DURATION;
+        }
+    }
+
+    // The current file keeps playing until the new one is ready
+    return mediaOpener.start(filename, options, decoderOptions);
+}
+
+void MediaPlayer::handleOpenProgress(OpenStage stage) {
+    std::cout << "Open: " << MediaOpener::getStageName(stage) << std::endl;
+
+    if (stage == OpenStage::Ready) {
+        switchToOpenedMedia();
+    }
+    else if (stage == OpenStage::Failed) {
+        std::cerr << "Failed to load media file" << std::endl;
+        startupProfiler.report();
+    }
+}
+
+bool MediaPlayer::switchToOpenedMedia() {
+    OpenedMedia media;
+    if (!mediaOpener.takeResult(media)) {
+        return false;
+    }
 
     // Stop current playback
     stop();
@@ -388,6 +857,8 @@ bool MediaPlayer::loadMediaFile(const std::string& filename) {
     // Reset state
     hasVideo = false;
     hasAudio = false;
+    hasVideoFrame = false;
+    invalidate();
 
     // Clean up existing textures
     if (videoTexture) {
@@ -395,61 +866,346 @@ bool MediaPlayer::loadMediaFile(const std::string& filename) {
         videoTexture = nullptr;
     }
 
-    // Try to load as video file first
-    if (videoDecoder->OpenFile(filename)) {
-        hasVideo = true;
+    // Decoders and thumbnails read from the demuxer, so they go first
+    thumbnailEngine->cancel();
+    videoDecoder->close();
+    audioDecoder->close();
+    demuxer->close();
+    startupProfiler.mark("previous file closed");
 
+    // Switch over in one go to the already opened file
+    demuxer = std::move(media.demuxer);
+    videoDecoder = std::move(media.videoDecoder);
+    audioDecoder = std::move(media.audioDecoder);
+    hasVideo = media.hasVideo;
+    hasAudio = media.hasAudio;
+
+    if (hasVideo) {
         // Create texture for video rendering
-        videoTexture = SDL_CreateTexture(
-            sdlRenderer,
-            SDL_PIXELFORMAT_RGB24,
-            SDL_TEXTUREACCESS_STREAMING,
-            videoDecoder->getWidth(),
-            videoDecoder->getHeight()
-        );
-
-        if (!videoTexture) {
+        if (!createVideoTexture(videoDecoder->getWidth(), videoDecoder->getHeight())) {
             std::cerr << "Failed to create video texture: " << SDL_GetError() << std::endl;
+            videoDecoder->close();
             hasVideo = false;
         }
-    }
-
-    // Try to load audio (might be separate or part of video file)
-    if (audioDecoder->openFile(filename)) {
-        hasAudio = true;
+        else {
+            updateVideoOutputSize();
+            startupProfiler.mark("texture created");
+        }
     }
 
     if (!hasVideo && !hasAudio) {
-        std::cerr << "Failed to load media file: " << filename << std::endl;
+        std::cerr << "Failed to load media file: " << media.filename << std::endl;
+        audioDecoder->close();
+        demuxer->close();
         return false;
     }
 
-    currentFile = filename;
+    // Sinks that cannot be written are dropped, the screen and device
+    // take over
+    if (hasVideo && videoSink && !videoSink->open(videoDecoder->getWidth(), videoDecoder->getHeight(), videoDecoder->getFrameRate())) {
+        std::cerr << "Video output disabled" << std::endl;
+        videoSink.reset();
+    }
+    if (hasAudio && audioSink && !audioSink->open(audioDecoder->getSampleRate(), audioDecoder->getOutputChannels())) {
+        std::cerr << "Audio output disabled" << std::endl;
+        audioSink.reset();
+    }
+
+    syncEngine.setStreams(hasAudio, hasVideo);
+    syncEngine.resetStats();
+
+    // Start reading packets for the attached streams
+    demuxer->start();
 
-    std::cout << "Media file loaded successfully!" << std::endl;
+    currentFile = media.filename;
+
+    std::cout << "Media file loaded successfully in " << media.openSeconds << "s!" << std::endl;
     if (hasVideo) std::cout << "  - Video stream found" << std::endl;
     if (hasAudio) std::cout << "  - Audio stream found" << std::endl;
-    std::cout << "Press SPACE to play" << std::endl;
+    if (fastStart) {
+        play();
+    }
+    else {
+        std::cout << "Press SPACE to play" << std::endl;
+    }
 
     return true;
 }
 
+void MediaPlayer::startAudio() {
+    finishAudioStart();
+
+    // Benchmarks pull samples themselves instead of opening a device
+    bool openDevice = !runOptions.bench;
+    if (!fastStart) {
+        if (audioDecoder->startPlayback(openDevice)) {
+            startupProfiler.mark("audio device opened");
+        }
+        return;
+    }
+
+    // The device opens and the ring fills beside the first video frame
+    audioStarting = true;
+    audioStartThread = std::thread([this, openDevice] {
+        if (audioDecoder->startPlayback(openDevice)) {
+            startupProfiler.mark("audio device opened");
+        }
+        audioStarting = false;
+    });
+}
+
+void MediaPlayer::finishAudioStart() {
+    if (audioStartThread.joinable()) {
+        audioStartThread.join();
+    }
+}
+
+void MediaPlayer::updateStartupProfile() {
+    if (!startupProfiler.isActive() || mediaOpener.isBusy()) {
+        return;
+    }
+
+    if (StartupProfiler::now() - startupProfiler.getStartTime() > STARTUP_PROFILE_TIMEOUT_SECONDS * 1000000.0) {
+        startupProfiler.mark("timed out");
+        startupProfiler.report();
+        return;
+    }
+
+    // Decoders stamp their first output themselves; it is picked up here
+    bool videoDone = !hasVideo || startupProfiler.hasMark("first picture shown");
+    bool audioDone = !hasAudio;
+    if (hasVideo && !startupProfiler.hasMark("first picture decoded") && videoDecoder->getFirstPictureTime() >= 0) {
+        startupProfiler.mark("first picture decoded", videoDecoder->getFirstPictureTime());
+    }
+    if (hasAudio && audioDecoder->getFirstSampleTime() >= 0) {
+        if (!startupProfiler.hasMark("first sample audible")) {
+            startupProfiler.mark("first sample audible", audioDecoder->getFirstSampleTime());
+        }
+        audioDone = true;
+    }
+
+    if (videoDone && audioDone) {
+        startupProfiler.report();
+    }
+}
+
+void MediaPlayer::updateRun() {
+    if (!playing) {
+        return;
+    }
+
+    double now = getMonotonicTime();
+    if (runStartTime < 0.0) {
+        runStartTime = now;
+        nextSeekTime = now + SEEK_TEST_SECONDS;
+    }
+
+    // Steady state begins once the run has warmed up
+    if (runOptions.allocationCheck && allocationStartTime < 0.0 && now - runStartTime >= ALLOCATION_WARMUP_SECONDS) {
+        startAllocationCheck(now);
+    }
+
+    if (runOptions.duration > 0.0 && now - runStartTime >= runOptions.duration) {
+        std::cout << "Run duration reached" << std::endl;
+        running = false;
+        return;
+    }
+
+    if (hasMediaEnded()) {
+        if (runOptions.loop) {
+            runStats.loops++;
+            seekToTime(0.0);
+        }
+        else if (runOptions.exitAtEnd) {
+            running = false;
+            return;
+        }
+        else {
+            // Nothing more will change on screen; pausing redraws the last
+            // picture once and lets the loop block on input
+            std::cout << "End of media reached" << std::endl;
+            pause();
+            return;
+        }
+    }
+
+    // Jump to repeatable pseudo-random positions, timing each seek up to
+    // its first picture
+    if (runOptions.seekTest && now >= nextSeekTime) {
+        double duration = getDuration();
+        if (duration > 0.0) {
+            double target = seekRandom() / 4294967296.0 * duration * SEEK_TEST_RANGE;
+            runStats.seeks++;
+            seekStartTime = hasVideo ? now : -1.0;
+            seekToTime(target);
+        }
+        nextSeekTime = now + SEEK_TEST_SECONDS;
+    }
+}
+
+void MediaPlayer::countShownPicture() {
+    runStats.framesShown++;
+
+    if (seekStartTime >= 0.0) {
+        double latency = getMonotonicTime() - seekStartTime;
+        runStats.seeksTimed++;
+        runStats.seekLatencyTotal += latency;
+        runStats.seekLatencyWorst = std::max(runStats.seekLatencyWorst, latency);
+        seekStartTime = -1.0;
+    }
+}
+
+bool MediaPlayer::hasMediaEnded() const {
+    // The demuxer reaches the end first; decoders still holding an end of
+    // stream from before a seek do not count
+    if (!demuxer->hasEnded()) {
+        return false;
+    }
+    return (!hasVideo || videoDecoder->hasEnded()) &&
+        (!hasAudio || (!audioStarting && audioDecoder->hasEnded()));
+}
+
+void MediaPlayer::pullBenchAudio() {
+    if (audioStarting || !audioDecoder->isPlaying() || audioDecoder->getRingFill() <= 0.0) {
+        return;
+    }
+
+    // Take what was decoded so the decoder never waits for room
+    benchAudioBuffer.resize(BENCH_AUDIO_BYTES);
+    size_t frames = audioDecoder->readSamples(benchAudioBuffer.data(), BENCH_AUDIO_BYTES);
+    if (audioSink && frames > 0) {
+        audioSink->writeSamples(reinterpret_cast<const int16_t*>(benchAudioBuffer.data()), frames);
+    }
+}
+
+uint64_t MediaPlayer::getPoolMisses() const {
+    if (!hasVideo) {
+        return 0;
+    }
+    return videoDecoder->getDecodePoolStats().misses + videoDecoder->getOutputPoolStats().misses;
+}
+
+void MediaPlayer::startAllocationCheck(double now) {
+    allocationStartTime = now;
+    allocationStartPoolMisses = getPoolMisses();
+    startAllocationCount();
+}
+
+void MediaPlayer::finishAllocationCheck() {
+    if (allocationStartTime < 0.0) {
+        std::cout << "Allocation check: the run ended within the "
+            << ALLOCATION_WARMUP_SECONDS << "s warm-up, nothing counted" << std::endl;
+        return;
+    }
+
+    stopAllocationCount();
+    AllocationCount count = getAllocationCount();
+    runStats.allocationsCounted = true;
+    runStats.steadySeconds = getMonotonicTime() - allocationStartTime;
+    runStats.steadyAllocations = count.allocations;
+    runStats.steadyAllocatedBytes = count.bytes;
+    // A pool reset by a format change starts its count over
+    uint64_t poolMisses = getPoolMisses();
+    runStats.steadyPoolBuffers = poolMisses >= allocationStartPoolMisses ?
+        poolMisses - allocationStartPoolMisses : poolMisses;
+
+    bool passed = runStats.steadyAllocations == 0 && runStats.steadyPoolBuffers == 0;
+    std::cout << "Allocation check " << (passed ? "passed" : "FAILED") << ": "
+        << runStats.steadyAllocations << " allocations (" << runStats.steadyAllocatedBytes << " bytes), "
+        << runStats.steadyPoolBuffers << " pool buffers added over " << runStats.steadySeconds
+        << "s of steady state" << std::endl;
+}
+
+void MediaPlayer::printRunSummary() {
+    double wallSeconds = runStartTime >= 0.0 ? getMonotonicTime() - runStartTime : 0.0;
+
+    VideoDecodeStats decode = {};
+    LatenessStats lateness = {};
+    if (hasVideo) {
+        decode = videoDecoder->getDecodeStats();
+        lateness = videoDecoder->getLatenessStats();
+    }
+    AudioLatencyStats audioLatency = {};
+    if (hasAudio) {
+        audioLatency = audioDecoder->getLatencyStats();
+    }
+
+    // Threads still run here, so their CPU time can be read; what is left
+    // over went to codec worker threads, the audio callback and SDL
+    double processCpu = getProcessCpuTime();
+    double mainCpu = getThreadCpuTime();
+    double demuxCpu = demuxer->getThreadCpuTime();
+    double videoCpu = hasVideo ? videoDecoder->getThreadCpuTime() : 0.0;
+    double audioCpu = hasAudio ? audioDecoder->getThreadCpuTime() : 0.0;
+    double otherCpu = std::max(0.0, processCpu - mainCpu - demuxCpu - videoCpu - audioCpu);
+
+    double fps = wallSeconds > 0.0 ? runStats.framesShown / wallSeconds : 0.0;
+    double decodeFps = wallSeconds > 0.0 ? decode.framesDecoded / wallSeconds : 0.0;
+    double seekAverage = runStats.seeksTimed > 0 ? runStats.seekLatencyTotal / runStats.seeksTimed : 0.0;
+
+    // One line of JSON for scripts, after everything else that was printed
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3)
+        << "{\"file\":\"" << escapeJson(currentFile) << "\""
+        << ",\"mode\":\"" << (runOptions.bench ? "bench" : "playback") << "\""
+        << ",\"headless\":" << (runOptions.headless ? "true" : "false")
+        << ",\"wall_seconds\":" << wallSeconds
+        << ",\"frames_decoded\":" << decode.framesDecoded
+        << ",\"frames_shown\":" << runStats.framesShown
+        << ",\"fps\":" << fps
+        << ",\"decode_fps\":" << decodeFps
+        << ",\"frames_dropped\":" << (syncEngine.getStats().framesDropped + lateness.framesDropped)
+        << ",\"audio_underruns\":" << audioLatency.underruns
+        << ",\"audio_buffer\":{\"frames\":" << audioLatency.bufferFrames
+        << ",\"latency_ms\":" << audioLatency.latencyMs
+        << ",\"resizes\":" << audioLatency.resizes << "}"
+        << ",\"loops\":" << runStats.loops
+        << ",\"seeks\":" << runStats.seeks
+        << ",\"seek_latency_ms\":{\"average\":" << seekAverage * 1000.0
+        << ",\"worst\":" << runStats.seekLatencyWorst * 1000.0 << "}"
+        << ",\"cpu_seconds\":{\"process\":" << processCpu
+        << ",\"main\":" << mainCpu
+        << ",\"demux\":" << demuxCpu
+        << ",\"video_decode\":" << videoCpu
+        << ",\"audio_decode\":" << audioCpu
+        << ",\"other\":" << otherCpu << "}"
+        << ",\"peak_rss_mb\":" << getPeakMemoryUsage() / (1024.0 * 1024.0);
+    if (runStats.allocationsCounted) {
+        json << ",\"steady_allocations\":{\"seconds\":" << runStats.steadySeconds
+            << ",\"count\":" << runStats.steadyAllocations
+            << ",\"bytes\":" << runStats.steadyAllocatedBytes
+            << ",\"pool_buffers\":" << runStats.steadyPoolBuffers << "}";
+    }
+    json << "}";
+
+    // Messages still in the log ring would otherwise be written in the
+    // middle of the line
+    Logger::flush();
+    std::cout << json.str() << std::endl;
+}
+
 void MediaPlayer::syncAudioVideo() {
-    if (!playing) return;
-
-    // Simple sync - just check if both are playing
-    if (hasVideo && hasAudio) {
-        double videoTime = videoDecoder->getCurrentTime();
-        double audioTime = audioDecoder->getCurrentTime();
-
-        // Basic sync check (could be improved)
-        double timeDiff = std::abs(videoTime - audioTime);
-        if (timeDiff > 0.1) { // 100ms threshold
-            // For now, just log the difference
-            static int syncLogCount = 0;
-            if (++syncLogCount % 300 == 0) { // Log every 5 seconds at 60fps
-                std::cout << "A/V sync difference: " << timeDiff << "s" << std::endl;
-            }
+    double now = getMonotonicTime();
+
+    // The audio device position feeds the audio clock
+    if (hasAudio && !audioStarting && audioDecoder->isPlaying()) {
+        syncEngine.updateAudioClock(audioDecoder->getCurrentTime(), now);
+    }
+
+    // The video decoder sheds work when its frames fall behind this clock;
+    // benchmarks have no clock and keep every frame
+    if (hasVideo) {
+        videoDecoder->updateMasterClock(syncEngine.getMasterClock(now), playing && !runOptions.bench);
+    }
+
+    // Audio stretches towards the master when it is not the master itself
+    if (hasAudio) {
+        // Bench audio is not paced, and checksums need it left unresampled
+        audioDecoder->setSyncDrift(playing && !runOptions.bench ? syncEngine.getAudioDrift(now) : 0.0);
+
+        // An adaptive device buffer grows after underruns
+        if (!audioStarting) {
+            audioDecoder->adaptLatency();
         }
     }
 }
@@ -460,12 +1216,28 @@ void MediaPlayer::cleanup() {
     // Stop playback
     stop();
 
+    // Finish the output files
+    if (videoSink) {
+        videoSink->close();
+        videoSink.reset();
+    }
+    if (audioSink) {
+        audioSink->close();
+        audioSink.reset();
+    }
+
     // Clean up video
     if (videoTexture) {
         SDL_DestroyTexture(videoTexture);
         videoTexture = nullptr;
     }
 
+    mediaOpener.cancel();
+
+    if (thumbnailEngine) {
+        thumbnailEngine->cancel();
+    }
+
     if (videoDecoder) {
         videoDecoder->close();
     }
@@ -474,6 +1246,10 @@ void MediaPlayer::cleanup() {
         audioDecoder->close();
     }
 
+    if (demuxer) {
+        demuxer->close();
+    }
+
     if (sdlRenderer) {
         SDL_DestroyRenderer(sdlRenderer);
         sdlRenderer = nullptr;
@@ -490,26 +1266,55 @@ void MediaPlayer::cleanup() {
 
 // Media control methods
 bool MediaPlayer::openFile(const std::string& filename) {
-    return loadMediaFile(filename);
+    if (!loadMediaFile(filename)) {
+        return false;
+    }
+
+    // The ready event still arrives later and finds nothing left to take
+    mediaOpener.wait();
+    return switchToOpenedMedia();
 }
 
 void MediaPlayer::play() {
     if ((hasVideo || hasAudio) && !playing) {
         std::cout << "Starting playback..." << std::endl;
+        startupProfiler.mark("play");
 
+        // Playing again after the end starts over
+        if (hasMediaEnded()) {
+            seekToTime(0.0);
+        }
+
+        // A paused device is resumed; startPlayback would return at once
+        // and leave it paused
         if (hasAudio) {
-            audioDecoder->startPlayback();
+            finishAudioStart();
+            if (audioDecoder->isPaused()) {
+                audioDecoder->resumePlayback();
+            }
+            else {
+                startAudio();
+            }
         }
 
         playing = true;
+        syncEngine.setPaused(false, getMonotonicTime());
+        endIdle();
+        invalidate();
         std::cout << "Playback started" << std::endl;
     }
 }
 
 void MediaPlayer::pause() {
+    finishAudioStart();
+
     if ((hasVideo || hasAudio) && playing) {
         std::cout << "Pausing playback..." << std::endl;
 
+        // Freeze the clocks where playback stopped
+        syncEngine.setPaused(true, getMonotonicTime());
+        invalidate();
+
         if (hasAudio) {
             audioDecoder->pausePlayback();
         }
@@ -520,6 +1325,8 @@ void MediaPlayer::pause() {
 }
 
 void MediaPlayer::stop() {
+    finishAudioStart();
+
     if (hasVideo || hasAudio) {
         std::cout << "Stopping playback..." << std::endl;
 
@@ -528,9 +1335,23 @@ void MediaPlayer::stop() {
         }
 
         playing = false;
+        printSyncStats();
+        frameScheduler.printStats();
+        frameScheduler.resetStats();
+        syncEngine.setPaused(true, getMonotonicTime());
+        invalidate();
+        resetPlaybackClock(0.0);
+        syncEngine.resetStats();
 
         // Seek back to beginning
-        if (hasVideo && videoDecoder->isFileOpen()) {
+        bool rewindVideo = hasVideo && videoDecoder->isFileOpen();
+        if (rewindVideo) {
+            videoDecoder->prepareSeek(0.0);
+        }
+        if (!demuxer->seekToTime(0.0)) {
+            std::cerr << "Failed to rewind media file" << std::endl;
+        }
+        if (rewindVideo) {
             videoDecoder->seekToTime(0.0);
         }
         if (hasAudio && audioDecoder->isFileOpen()) {
@@ -550,7 +1371,21 @@ bool MediaPlayer::seekToTime(double seconds) {
         return false;
     }
 
-    std::cout << "Seeking to: " << formatTime(seconds) << std::endl;
+    LOG_INFO("Seeking to: %s", formatTime(seconds).c_str());
+    TRACE_SCOPE("seek");
+    finishAudioStart();
+
+    // Reposition the shared demuxer once, then reset each decoder; the
+    // video target must be in place before the demuxer queues new packets
+    if (hasVideo) {
+        videoDecoder->prepareSeek(seconds);
+    }
+    if (!demuxer->seekToTime(seconds)) {
+        if (hasVideo) {
+            videoDecoder->cancelSeek();
+        }
+        return false;
+    }
 
     bool success = true;
 
@@ -562,9 +1397,33 @@ bool MediaPlayer::seekToTime(double seconds) {
         success &= audioDecoder->seekToTime(seconds);
     }
 
+    resetPlaybackClock(seconds);
+    invalidate();
     return success;
 }
 
+void MediaPlayer::generateContactSheet() {
+    if (!hasVideo || thumbnailEngine->isBusy()) {
+        return;
+    }
+
+    ThumbnailOptions options;
+    options.atlasPath = currentFile + ".thumbs.bmp";
+    thumbnailEngine->setKeyframeIndex(&demuxer->getKeyframeIndex());
+    if (thumbnailEngine->start(currentFile, options)) {
+        std::cout << "Generating contact sheet: " << options.atlasPath << std::endl;
+    }
+}
+
+bool MediaPlayer::seekToFrame(int64_t frameNumber) {
+    if (!hasVideo) {
+        return false;
+    }
+
+    LOG_INFO("Seeking to frame: %lld", (long long)frameNumber);
+    return seekToTime(demuxer->getFrameTime(frameNumber));
+}
+
 double MediaPlayer::getCurrentTime() const {
     if (hasVideo) {
         return videoDecoder->getCurrentTime();
@@ -575,6 +1434,53 @@ double MediaPlayer::getCurrentTime() const {
     return 0.0;
 }
 
+double MediaPlayer::getPlaybackClock() const {
+    return syncEngine.getMasterClock(getMonotonicTime());
+}
+
+void MediaPlayer::resetPlaybackClock(double seconds) {
+    syncEngine.reset(seconds, getMonotonicTime());
+}
+
+double MediaPlayer::getMonotonicTime() const {
+    return FrameScheduler::now();
+}
+
+void MediaPlayer::cycleSyncMaster() {
+    SyncMaster next;
+    switch (syncEngine.getMaster()) {
+    case SyncMaster::Audio: next = SyncMaster::Video; break;
+    case SyncMaster::Video: next = SyncMaster::External; break;
+    default: next = SyncMaster::Audio; break;
+    }
+
+    // Every clock restarts from the current position under the new master
+    double position = getPlaybackClock();
+    syncEngine.setMaster(next);
+    resetPlaybackClock(position);
+
+    if (syncEngine.getEffectiveMaster() != next) {
+        LOG_INFO("Sync master: %s (using %s)", SyncEngine::getMasterName(next),
+            SyncEngine::getMasterName(syncEngine.getEffectiveMaster()));
+    }
+    else {
+        LOG_INFO("Sync master: %s", SyncEngine::getMasterName(next));
+    }
+}
+
+void MediaPlayer::printSyncStats() const {
+    const SyncStats& stats = syncEngine.getStats();
+    if (stats.framesShown == 0) {
+        return;
+    }
+
+    LOG_INFO("Sync (%s master): %llu shown, %llu dropped, %llu repeated, %llu corrected, drift %gms (max %gms)",
+        SyncEngine::getMasterName(syncEngine.getEffectiveMaster()),
+        (unsigned long long)stats.framesShown, (unsigned long long)stats.framesDropped,
+        (unsigned long long)stats.framesRepeated, (unsigned long long)stats.corrections,
+        stats.drift * 1000.0, stats.maxDrift * 1000.0);
+}
+
 double MediaPlayer::getDuration() const {
     if (hasVideo) {
         return videoDecoder->getDuration();
@@ -588,7 +1494,8 @@ double MediaPlayer::getDuration() const {
 // Volume control methods
 void MediaPlayer::setVolume(float newVolume) {
     volume = std::clamp(newVolume, 0.0f, 1.0f);
-    std::cout << "Volume set to: " << (int)(volume * 100) << "%" << std::endl;
+    invalidate();
+    LOG_INFO("Volume set to: %d%%", (int)(volume * 100));
 
     // TODO: Implement actual volume control in audio decoder
     // For now, just store the value
@@ -601,7 +1508,8 @@ float MediaPlayer::getVolume() const {
 void MediaPlayer::mute() {
     if (!muted) {
         muted = true;
-        std::cout << "Audio muted" << std::endl;
+        invalidate();
+        LOG_INFO("Audio muted");
 
         // TODO: Implement actual muting in audio decoder
     }
@@ -610,7 +1518,8 @@ void MediaPlayer::mute() {
 void MediaPlayer::unmute() {
     if (muted) {
         muted = false;
-        std::cout << "Audio unmuted" << std::endl;
+        invalidate();
+        LOG_INFO("Audio unmuted");
 
         // TODO: Implement actual unmuting in audio decoder
     }
@@ -3,10 +3,51 @@
 #define MEDIAPLAYER_H
 
 #include <string>
+#include <vector>
 #include <memory>
+#include <thread>
+#include <atomic>
+#include <random>
 #include <SDL.h>
+#include "Demuxer.h"
 #include "VideoDecoder.h"
 #include "AudioDecoder.h"
+#include "ThumbnailEngine.h"
+#include "MediaOpener.h"
+#include "SyncEngine.h"
+#include "FrameScheduler.h"
+#include "StartupProfiler.h"
+#include "PerformanceHud.h"
+#include "OutputSink.h"
+
+// How a command-line run behaves; set before initialize
+struct RunOptions {
+    bool headless = false;      // Hidden window, dummy video and disk audio drivers
+    bool bench = false;         // Pictures and samples taken as fast as they decode
+    double duration = 0.0;      // Seconds of playback before exiting, 0 = no limit
+    bool loop = false;          // Start over at the end of the file
+    bool seekTest = false;      // Seek somewhere else every SEEK_TEST_SECONDS
+    bool allocationCheck = false;   // Count allocations once warmed up
+    bool exitAtEnd = false;
+    bool summary = false;       // JSON summary on stdout once the run ends
+};
+
+struct RunStats {
+    uint64_t framesShown;
+    uint64_t loops;
+    uint64_t seeks;
+    uint64_t seeksTimed;        // Seeks that got a picture on screen
+    double seekLatencyTotal;    // Seek to first picture, seconds
+    double seekLatencyWorst;
+
+    // Allocation check, counted from ALLOCATION_WARMUP_SECONDS into the
+    // run to its end; seeks and loops allocate and are counted too
+    bool allocationsCounted;
+    double steadySeconds;
+    uint64_t steadyAllocations;
+    uint64_t steadyAllocatedBytes;
+    uint64_t steadyPoolBuffers;     // Picture buffers the frame pools had to add
+};
 
 class MediaPlayer {
 public:
@@ -17,8 +58,22 @@ public:
     void run();
     void cleanup();
 
-    // Media control
+    // Media control. openFile waits for the file to open; the O key opens
+    // in the background while the current file keeps playing.
     bool openFile(const std::string& filename);
+    void setOpenOptions(const DemuxerOptions& options) { openOptions = options; }
+
+    // Fast start probes less, plays as soon as a file is open and opens
+    // the audio device while the first picture goes up
+    void setFastStart(bool enabled) { fastStart = enabled; }
+    void setDecoderOptions(const DecoderOptions& options) { decoderOptions = options; }
+    void setRunOptions(const RunOptions& options) { runOptions = options; }
+    const RunStats& getRunStats() const { return runStats; }
+
+    // Sinks take pictures or samples in place of the screen or the audio
+    // device. They are fed in bench mode, as fast as the decoders go.
+    void setVideoSink(std::unique_ptr<VideoSink> sink) { videoSink = std::move(sink); }
+    void setAudioSink(std::unique_ptr<AudioSink> sink) { audioSink = std::move(sink); }
     void play();
     void pause();
     void stop();
@@ -26,6 +81,7 @@ public:
 
     // Seeking
     bool seekToTime(double seconds);
+    bool seekToFrame(int64_t frameNumber);
     double getCurrentTime() const;
     double getDuration() const;
 
@@ -40,14 +96,49 @@ private:
     static const int WINDOW_WIDTH = 1280;
     static const int WINDOW_HEIGHT = 720;
 
+    // The main loop wakes at least this often to keep the clocks fed
+    static constexpr double MAX_WAIT_SECONDS = 0.1;
+
+    // The overlay's decode rate is measured over this long
+    static constexpr double HUD_SAMPLE_SECONDS = 0.5;
+
+    // Idle periods shorter than this are not reported
+    static constexpr double MIN_IDLE_REPORT_SECONDS = 1.0;
+
+    // Seek test interval, and the part of the file it seeks into
+    static constexpr double SEEK_TEST_SECONDS = 1.0;
+    static constexpr double SEEK_TEST_RANGE = 0.9;
+
+    // Bench mode pulls this much audio at a time, and sleeps this long
+    // when nothing is decoded yet
+    static const int BENCH_AUDIO_BYTES = 16384;
+    static constexpr double BENCH_WAIT_SECONDS = 0.001;
+
+    // Queues, pools and scalers have settled this far into a run
+    static constexpr double ALLOCATION_WARMUP_SECONDS = 2.0;
+
+    // A startup profile still waiting for its first output this long after
+    // the request (opened paused, no picture decodable) is reported as is
+    static constexpr double STARTUP_PROFILE_TIMEOUT_SECONDS = 10.0;
+
     // SDL components
     SDL_Window* window;
     SDL_Renderer* sdlRenderer;
 
-    // Media decoders
+    // Media demuxer and decoders
+    std::unique_ptr<Demuxer> demuxer;
     std::unique_ptr<VideoDecoder> videoDecoder;
     std::unique_ptr<AudioDecoder> audioDecoder;
 
+    // Contact sheet generation for the open file
+    std::unique_ptr<ThumbnailEngine> thumbnailEngine;
+
+    // Background opening; progress arrives as openEventType SDL events
+    MediaOpener mediaOpener;
+    DemuxerOptions openOptions;
+    DecoderOptions decoderOptions;
+    Uint32 openEventType;
+
     // Application state
     bool running;
     bool playing;
@@ -56,24 +147,104 @@ private:
 
     // Video components
     SDL_Texture* videoTexture;
+    Uint32 videoTextureFormat;
     bool hasVideo;
     bool hasAudio;
+    bool hasVideoFrame;
+    int videoTextureWidth;
+    int videoTextureHeight;
+
+    // Master clock selection and picture scheduling
+    SyncEngine syncEngine;
+
+    // Main loop pacing; due time and pts of the picture the current render
+    // shows
+    FrameScheduler frameScheduler;
+    double shownFrameDue;
+    double shownFramePts;
+    uint64_t shownFrameSequence;
+
+    // Set whenever what is on screen changes; nothing is drawn otherwise
+    bool needsRedraw;
+
+    // Idle accounting, idleStartTime < 0 while playing
+    double idleStartTime;
+    double idleStartCpu;
+    uint64_t idleWakeups;
+    uint64_t idleRedraws;
 
     // Current media file
     std::string currentFile;
 
+    // Performance overlay (H)
+    PerformanceHud hud;
+    std::vector<std::string> hudLines;
+    double hudSampleTime;
+    uint64_t hudSampleFrames;
+    double decodeFps;
+    double uploadMs;    // Smoothed texture upload time
+    double hudMs;       // What the last overlay took to draw
+
+    // Time to first picture and first sample
+    StartupProfiler startupProfiler;
+    bool fastStart;
+    std::thread audioStartThread;
+    std::atomic<bool> audioStarting;
+
+    // Command-line runs: limits, looping, the seek test and their summary
+    RunOptions runOptions;
+    RunStats runStats;
+    double runStartTime;    // When playback first started, < 0 before
+    double nextSeekTime;
+    double seekStartTime;   // < 0 unless a seek waits for its first picture
+    std::mt19937 seekRandom;
+    double allocationStartTime;     // < 0 until allocations are counted
+    uint64_t allocationStartPoolMisses;
+    std::vector<uint8_t> benchAudioBuffer;
+    std::unique_ptr<VideoSink> videoSink;
+    std::unique_ptr<AudioSink> audioSink;
+
     // Private methods
     bool initializeSDL();
     bool initializeFFmpeg();
     void handleEvents();
+    double getNextWakeTime() const;
     void render();
+    void updateVideoFrame();
     void renderVideoFrame();
+    void invalidate();
+    void beginIdle();
+    void endIdle();
+    bool createVideoTexture(int width, int height);
+    void uploadVideoPicture(const VideoPicture* picture);
+    SDL_Rect calculateDisplayRect() const;
+    void updateVideoOutputSize();
+    void generateContactSheet();
     void renderAudioVisualization();
     void renderControls();
+    void renderHud();
     bool loadVideoFile(const std::string& filename);
     bool loadAudioFile(const std::string& filename);
     bool loadMediaFile(const std::string& filename);
+    void handleOpenProgress(OpenStage stage);
+    bool switchToOpenedMedia();
     void syncAudioVideo();
+    void startAudio();
+    void finishAudioStart();
+    void updateStartupProfile();
+    void updateRun();
+    void countShownPicture();
+    bool hasMediaEnded() const;
+    void pullBenchAudio();
+    uint64_t getPoolMisses() const;
+    void startAllocationCheck(double now);
+    void finishAllocationCheck();
+    void printRunSummary();
+    double getPlaybackClock() const;
+    void resetPlaybackClock(double seconds);
+    double getMonotonicTime() const;
+    void cycleSyncMaster();
+    void printSyncStats() const;
     void updateTimeDisplay();
 
     // Helper methods
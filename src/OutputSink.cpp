@@ -0,0 +1,395 @@
+// OutputSink.cpp
+#include "OutputSink.h"
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/rational.h>
+}
+
+namespace {
+// Writes reach the file in blocks of this size
+const size_t FILE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+const size_t WAV_HEADER_SIZE = 44;
+const double DEFAULT_FRAME_RATE = 25.0;
+
+void putLittleEndian(uint8_t* destination, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        destination[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    if (text.size() < suffix.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < suffix.size(); i++) {
+        char c = text[text.size() - suffix.size() + i];
+        if (tolower((unsigned char)c) != suffix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double megabytes(uint64_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+}
+
+BufferedFile::BufferedFile()
+    : used(0)
+    , bytesWritten(0)
+    , failed(false) {
+}
+
+BufferedFile::~BufferedFile() {
+    close();
+}
+
+bool BufferedFile::open(const std::string& path) {
+    close();
+
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Could not open output file: " << path << std::endl;
+        return false;
+    }
+
+    buffer.resize(FILE_BUFFER_SIZE);
+    used = 0;
+    bytesWritten = 0;
+    failed = false;
+    return true;
+}
+
+bool BufferedFile::write(const void* data, size_t size) {
+    if (failed || !file.is_open()) {
+        return false;
+    }
+
+    if (used + size > buffer.size()) {
+        flush();
+    }
+
+    // Blocks larger than the buffer go straight through
+    if (size >= buffer.size()) {
+        file.write(static_cast<const char*>(data), (std::streamsize)size);
+        failed = !file;
+    }
+    else {
+        memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    bytesWritten += size;
+    return !failed;
+}
+
+bool BufferedFile::writeAt(uint64_t offset, const void* data, size_t size) {
+    if (!flush()) {
+        return false;
+    }
+
+    file.seekp((std::streamoff)offset);
+    file.write(static_cast<const char*>(data), (std::streamsize)size);
+    file.seekp(0, std::ios::end);
+    failed = !file;
+    return !failed;
+}
+
+bool BufferedFile::flush() {
+    if (used > 0 && !failed) {
+        file.write(reinterpret_cast<const char*>(buffer.data()), (std::streamsize)used);
+        failed = !file;
+    }
+    used = 0;
+    return !failed;
+}
+
+bool BufferedFile::close() {
+    if (!file.is_open()) {
+        return !failed;
+    }
+
+    flush();
+    file.close();
+    if (failed) {
+        std::cerr << "Writing output file failed" << std::endl;
+    }
+    return !failed;
+}
+
+bool NullVideoSink::open(int, int, double) {
+    framesWritten = 0;
+    return true;
+}
+
+bool NullVideoSink::writePicture(const AVFrame*, double) {
+    framesWritten++;
+    return true;
+}
+
+void NullVideoSink::close() {
+    std::cout << "Video sink null: " << framesWritten << " pictures" << std::endl;
+}
+
+RawVideoSink::RawVideoSink(const std::string& path)
+    : path(path)
+    , width(0)
+    , height(0)
+    , format(AV_PIX_FMT_NONE) {
+}
+
+bool RawVideoSink::open(int, int, double) {
+    // Later files of the run are appended
+    if (file.isOpen()) {
+        return true;
+    }
+    framesWritten = 0;
+    format = AV_PIX_FMT_NONE;
+    return file.open(path);
+}
+
+bool RawVideoSink::writePicture(const AVFrame* frame, double) {
+    // The first picture fixes the layout of the whole file
+    if (format == AV_PIX_FMT_NONE) {
+        width = frame->width;
+        height = frame->height;
+        format = (AVPixelFormat)frame->format;
+
+        int size = av_image_get_buffer_size(format, width, height, 1);
+        if (size <= 0) {
+            std::cerr << "Raw output cannot store this picture format" << std::endl;
+            return false;
+        }
+        pictureBuffer.resize(size);
+    }
+    if (frame->width != width || frame->height != height || frame->format != format) {
+        std::cerr << "Raw output: picture size or format changed, picture dropped" << std::endl;
+        return false;
+    }
+
+    av_image_copy_to_buffer(pictureBuffer.data(), (int)pictureBuffer.size(),
+        frame->data, frame->linesize, format, width, height, 1);
+    if (!file.write(pictureBuffer.data(), pictureBuffer.size())) {
+        return false;
+    }
+
+    framesWritten++;
+    return true;
+}
+
+void RawVideoSink::close() {
+    if (!file.isOpen()) {
+        return;
+    }
+
+    file.close();
+    const char* formatName = av_get_pix_fmt_name(format);
+    std::cout << "Video sink raw: " << framesWritten << " pictures " << width << "x" << height << " "
+        << (formatName ? formatName : "none") << ", " << megabytes(file.getBytesWritten())
+        << " MB to " << path << std::endl;
+}
+
+Y4mVideoSink::Y4mVideoSink(const std::string& path)
+    : path(path)
+    , frameRate(DEFAULT_FRAME_RATE)
+    , width(0)
+    , height(0) {
+}
+
+bool Y4mVideoSink::open(int, int, double rate) {
+    // Later files of the run are appended under the first one's header
+    if (file.isOpen()) {
+        return true;
+    }
+    framesWritten = 0;
+    frameRate = rate > 0.0 ? rate : DEFAULT_FRAME_RATE;
+    width = 0;
+    height = 0;
+    return file.open(path);
+}
+
+bool Y4mVideoSink::writeHeader(const AVFrame* frame) {
+    switch (frame->format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+    case AV_PIX_FMT_NV12:
+    case AV_PIX_FMT_NV21:
+        break;
+    default:
+        std::cerr << "Y4M output needs 4:2:0 pictures, got "
+            << av_get_pix_fmt_name((AVPixelFormat)frame->format) << "; use a raw output" << std::endl;
+        return false;
+    }
+
+    width = frame->width;
+    height = frame->height;
+
+    AVRational rate = av_d2q(frameRate, 1000000);
+    char header[128];
+    snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg%s\n",
+        width, height, rate.num, rate.den,
+        frame->format == AV_PIX_FMT_YUVJ420P ? " XCOLORRANGE=FULL" : "");
+    return file.write(header, strlen(header));
+}
+
+bool Y4mVideoSink::writePicture(const AVFrame* frame, double) {
+    // A format Y4M cannot hold is reported once
+    if (width == 0 && !writeHeader(frame)) {
+        width = -1;
+    }
+    if (width < 0) {
+        return false;
+    }
+    if (frame->width != width || frame->height != height) {
+        std::cerr << "Y4M output: picture size changed, picture dropped" << std::endl;
+        return false;
+    }
+
+    static const char FRAME_HEADER[] = "FRAME\n";
+    file.write(FRAME_HEADER, sizeof(FRAME_HEADER) - 1);
+
+    for (int y = 0; y < height; y++) {
+        file.write(frame->data[0] + (size_t)y * frame->linesize[0], width);
+    }
+
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    if (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P) {
+        for (int plane = 1; plane <= 2; plane++) {
+            for (int y = 0; y < chromaHeight; y++) {
+                file.write(frame->data[plane] + (size_t)y * frame->linesize[plane], chromaWidth);
+            }
+        }
+    }
+    else {
+        // Split the interleaved chroma into U then V
+        size_t planeSize = (size_t)chromaWidth * chromaHeight;
+        chromaBuffer.resize(planeSize * 2);
+        uint8_t* u = chromaBuffer.data();
+        uint8_t* v = u + planeSize;
+        if (frame->format == AV_PIX_FMT_NV21) {
+            std::swap(u, v);
+        }
+        for (int y = 0; y < chromaHeight; y++) {
+            const uint8_t* source = frame->data[1] + (size_t)y * frame->linesize[1];
+            for (int x = 0; x < chromaWidth; x++) {
+                *u++ = source[2 * x];
+                *v++ = source[2 * x + 1];
+            }
+        }
+        file.write(chromaBuffer.data(), chromaBuffer.size());
+    }
+
+    framesWritten++;
+    return true;
+}
+
+void Y4mVideoSink::close() {
+    if (!file.isOpen()) {
+        return;
+    }
+
+    file.close();
+    std::cout << "Video sink y4m: " << framesWritten << " pictures " << width << "x" << height
+        << ", " << megabytes(file.getBytesWritten()) << " MB to " << path << std::endl;
+}
+
+bool NullAudioSink::open(int, int) {
+    framesWritten = 0;
+    return true;
+}
+
+bool NullAudioSink::writeSamples(const int16_t*, size_t frames) {
+    framesWritten += frames;
+    return true;
+}
+
+void NullAudioSink::close() {
+    std::cout << "Audio sink null: " << framesWritten << " sample frames" << std::endl;
+}
+
+WavAudioSink::WavAudioSink(const std::string& path)
+    : path(path)
+    , channels(0) {
+}
+
+bool WavAudioSink::open(int sampleRate, int channelCount) {
+    // Later files of the run are appended; the format stays the first one's
+    if (file.isOpen()) {
+        return true;
+    }
+    if (!file.open(path)) {
+        return false;
+    }
+
+    framesWritten = 0;
+    channels = channelCount;
+
+    // RIFF header with zero sizes, filled in on close
+    uint32_t blockAlign = (uint32_t)channels * sizeof(int16_t);
+    uint8_t header[WAV_HEADER_SIZE] = {};
+    memcpy(header, "RIFF", 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLittleEndian(header + 16, 16, 4);                        // fmt chunk size
+    putLittleEndian(header + 20, 1, 2);                         // PCM
+    putLittleEndian(header + 22, channels, 2);
+    putLittleEndian(header + 24, sampleRate, 4);
+    putLittleEndian(header + 28, sampleRate * blockAlign, 4);   // Bytes per second
+    putLittleEndian(header + 32, blockAlign, 2);
+    putLittleEndian(header + 34, 16, 2);                        // Bits per sample
+    memcpy(header + 36, "data", 4);
+    return file.write(header, sizeof(header));
+}
+
+bool WavAudioSink::writeSamples(const int16_t* samples, size_t frames) {
+    // Samples are stored as they are in memory, little-endian on every
+    // platform the player is built for
+    if (!file.write(samples, frames * channels * sizeof(int16_t))) {
+        return false;
+    }
+    framesWritten += frames;
+    return true;
+}
+
+void WavAudioSink::close() {
+    if (!file.isOpen()) {
+        return;
+    }
+
+    uint64_t dataSize = file.getBytesWritten() - WAV_HEADER_SIZE;
+    uint8_t size[4];
+    putLittleEndian(size, (uint32_t)std::min<uint64_t>(dataSize + WAV_HEADER_SIZE - 8, UINT32_MAX), 4);
+    file.writeAt(4, size, 4);
+    putLittleEndian(size, (uint32_t)std::min<uint64_t>(dataSize, UINT32_MAX), 4);
+    file.writeAt(40, size, 4);
+    file.close();
+
+    std::cout << "Audio sink wav: " << framesWritten << " sample frames, " << megabytes(file.getBytesWritten())
+        << " MB to " << path << std::endl;
+}
+
+std::unique_ptr<VideoSink> createVideoSink(const std::string& target) {
+    if (target == "null") {
+        return std::make_unique<NullVideoSink>();
+    }
+    if (endsWith(target, ".y4m")) {
+        return std::make_unique<Y4mVideoSink>(target);
+    }
+    return std::make_unique<RawVideoSink>(target);
+}
+
+std::unique_ptr<AudioSink> createAudioSink(const std::string& target) {
+    if (target == "null") {
+        return std::make_unique<NullAudioSink>();
+    }
+    return std::make_unique<WavAudioSink>(target);
+}
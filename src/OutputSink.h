@@ -0,0 +1,154 @@
+// OutputSink.h
+#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+// Collects small writes into large blocks before they reach the file
+class BufferedFile {
+public:
+    BufferedFile();
+    ~BufferedFile();
+
+    bool open(const std::string& path);
+    bool write(const void* data, size_t size);
+    // Overwrites earlier bytes, e.g. a header whose sizes are known last
+    bool writeAt(uint64_t offset, const void* data, size_t size);
+    bool close();
+
+    bool isOpen() const { return file.is_open(); }
+    uint64_t getBytesWritten() const { return bytesWritten; }
+
+private:
+    std::ofstream file;
+    std::vector<uint8_t> buffer;
+    size_t used;
+    uint64_t bytesWritten;
+    bool failed;
+
+    bool flush();
+};
+
+// Takes every picture instead of the screen, in presentation order.
+// Pictures arrive in the decoder's output format at their decoded size.
+class VideoSink {
+public:
+    virtual ~VideoSink() {}
+
+    virtual bool open(int width, int height, double frameRate) = 0;
+    virtual bool writePicture(const AVFrame* frame, double pts) = 0;
+    virtual void close() = 0;
+    virtual const char* getName() const = 0;
+
+    uint64_t getFramesWritten() const { return framesWritten; }
+
+protected:
+    uint64_t framesWritten = 0;
+};
+
+// Takes the samples instead of the audio device: interleaved signed
+// 16-bit, as the decoder outputs them
+class AudioSink {
+public:
+    virtual ~AudioSink() {}
+
+    virtual bool open(int sampleRate, int channels) = 0;
+    virtual bool writeSamples(const int16_t* samples, size_t frames) = 0;
+    virtual void close() = 0;
+    virtual const char* getName() const = 0;
+
+    uint64_t getFramesWritten() const { return framesWritten; }
+
+protected:
+    uint64_t framesWritten = 0;
+};
+
+// Counts pictures and touches nothing, for pure decode throughput
+class NullVideoSink : public VideoSink {
+public:
+    bool open(int width, int height, double frameRate) override;
+    bool writePicture(const AVFrame* frame, double pts) override;
+    void close() override;
+    const char* getName() const override { return "null"; }
+};
+
+// Planes back to back without padding, in whatever format the decoder
+// hands over; the format is printed on close
+class RawVideoSink : public VideoSink {
+public:
+    explicit RawVideoSink(const std::string& path);
+
+    bool open(int width, int height, double frameRate) override;
+    bool writePicture(const AVFrame* frame, double pts) override;
+    void close() override;
+    const char* getName() const override { return "raw"; }
+
+private:
+    std::string path;
+    BufferedFile file;
+    std::vector<uint8_t> pictureBuffer;
+    int width;
+    int height;
+    AVPixelFormat format;
+};
+
+// YUV4MPEG2 with 4:2:0 chroma; NV12/NV21 pictures are split into planes
+class Y4mVideoSink : public VideoSink {
+public:
+    explicit Y4mVideoSink(const std::string& path);
+
+    bool open(int width, int height, double frameRate) override;
+    bool writePicture(const AVFrame* frame, double pts) override;
+    void close() override;
+    const char* getName() const override { return "y4m"; }
+
+private:
+    std::string path;
+    BufferedFile file;
+    std::vector<uint8_t> chromaBuffer;
+    double frameRate;
+    int width;
+    int height;
+
+    bool writeHeader(const AVFrame* frame);
+};
+
+class NullAudioSink : public AudioSink {
+public:
+    bool open(int sampleRate, int channels) override;
+    bool writeSamples(const int16_t* samples, size_t frames) override;
+    void close() override;
+    const char* getName() const override { return "null"; }
+};
+
+// PCM WAV; the sizes in the header are filled in on close
+class WavAudioSink : public AudioSink {
+public:
+    explicit WavAudioSink(const std::string& path);
+
+    bool open(int sampleRate, int channels) override;
+    bool writeSamples(const int16_t* samples, size_t frames) override;
+    void close() override;
+    const char* getName() const override { return "wav"; }
+
+private:
+    std::string path;
+    BufferedFile file;
+    int channels;
+};
+
+// "null", a .y4m path, or any other path for raw pictures
+std::unique_ptr<VideoSink> createVideoSink(const std::string& target);
+// "null" or a .wav path
+std::unique_ptr<AudioSink> createAudioSink(const std::string& target);
+
+#endif // OUTPUTSINK_H
@@ -0,0 +1,161 @@
+// PacketQueue.cpp
+#include "PacketQueue.h"
+#include <chrono>
+
+namespace {
+// Below this many packets a consumer is about to run dry
+const size_t STARVING_PACKETS = 8;
+}
+
+PacketQueue::PacketQueue(size_t maxPackets)
+    : head(0)
+    , count(0)
+    , maxPackets(maxPackets)
+    , bytes(0)
+    , serial(0)
+    , aborted(false) {
+}
+
+PacketQueue::~PacketQueue() {
+    std::lock_guard<std::mutex> lock(mutex);
+    clearLocked();
+    for (Entry& entry : entries) {
+        av_packet_free(&entry.packet);
+    }
+    entries.clear();
+}
+
+bool PacketQueue::grow() {
+    // Only called when the ring is full, so every existing slot is in use
+    size_t oldCapacity = entries.size();
+    size_t newCapacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+    std::vector<Entry> newEntries(newCapacity, Entry{ nullptr, 0 });
+
+    for (size_t i = 0; i < oldCapacity; i++) {
+        newEntries[i] = entries[(head + i) % oldCapacity];
+    }
+
+    for (size_t i = oldCapacity; i < newCapacity; i++) {
+        newEntries[i].packet = av_packet_alloc();
+        if (!newEntries[i].packet) {
+            for (size_t j = oldCapacity; j < i; j++) {
+                av_packet_free(&newEntries[j].packet);
+            }
+            return false;
+        }
+    }
+
+    entries.swap(newEntries);
+    head = 0;
+    return true;
+}
+
+bool PacketQueue::put(AVPacket* packet) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (aborted) {
+        av_packet_unref(packet);
+        return false;
+    }
+
+    // The soft limit is enforced by the demuxer; grow only when the
+    // stream interleaving forces us past the preallocated ring
+    if (count == entries.size() && !grow()) {
+        av_packet_unref(packet);
+        return false;
+    }
+
+    Entry& entry = entries[(head + count) % entries.size()];
+    av_packet_move_ref(entry.packet, packet);
+    entry.serial = serial;
+    bytes += entry.packet->size;
+    count++;
+
+    condition.notify_one();
+    return true;
+}
+
+bool PacketQueue::putEndOfStream() {
+    AVPacket* packet = av_packet_alloc();
+    if (!packet) {
+        return false;
+    }
+
+    bool queued = put(packet);
+    av_packet_free(&packet);
+    return queued;
+}
+
+int PacketQueue::get(AVPacket* packet, int* serial, int timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (!condition.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+        [this] { return count > 0 || aborted; })) {
+        return 0;
+    }
+    if (aborted) {
+        return -1;
+    }
+
+    Entry& entry = entries[head];
+    av_packet_move_ref(packet, entry.packet);
+    if (serial) {
+        *serial = entry.serial;
+    }
+    bytes -= packet->size;
+    head = (head + 1) % entries.size();
+    count--;
+
+    return 1;
+}
+
+void PacketQueue::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    clearLocked();
+    serial++;
+}
+
+void PacketQueue::abort() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = true;
+    condition.notify_all();
+}
+
+void PacketQueue::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = false;
+    serial++;
+}
+
+void PacketQueue::clearLocked() {
+    for (size_t i = 0; i < count; i++) {
+        av_packet_unref(entries[(head + i) % entries.size()].packet);
+    }
+    head = 0;
+    count = 0;
+    bytes = 0;
+}
+
+bool PacketQueue::isFull() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count >= maxPackets;
+}
+
+bool PacketQueue::isStarving() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count < STARVING_PACKETS;
+}
+
+size_t PacketQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+}
+
+int64_t PacketQueue::byteSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes;
+}
+
+int PacketQueue::getSerial() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return serial;
+}
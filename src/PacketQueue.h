@@ -0,0 +1,64 @@
+// PacketQueue.h
+#ifndef PACKETQUEUE_H
+#define PACKETQUEUE_H
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+// Thread-safe packet queue between the demuxer thread and one decoder.
+// Every flush starts a new serial so decoders can tell stale packets
+// (queued before a seek) from fresh ones and flush their codec state.
+// An empty packet (no data, size 0) marks the end of the stream.
+class PacketQueue {
+public:
+    explicit PacketQueue(size_t maxPackets = 256);
+    ~PacketQueue();
+
+    // Producer side (demuxer thread), takes over the packet's reference
+    bool put(AVPacket* packet);
+    bool putEndOfStream();
+
+    // Consumer side, returns 1 when a packet was moved out,
+    // 0 on timeout and -1 once the queue has been aborted
+    int get(AVPacket* packet, int* serial, int timeoutMs);
+
+    // Drops everything queued and starts a new serial
+    void flush();
+    void abort();
+    void start();
+
+    // Queue state
+    bool isFull() const;
+    bool isStarving() const;
+    size_t size() const;
+    int64_t byteSize() const;
+    int getSerial() const;
+
+private:
+    struct Entry {
+        AVPacket* packet;
+        int serial;
+    };
+
+    // Ring storage, the packets are allocated once and reused
+    std::vector<Entry> entries;
+    size_t head;
+    size_t count;
+    size_t maxPackets;
+    int64_t bytes;
+    int serial;
+    bool aborted;
+
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+
+    bool grow();
+    void clearLocked();
+};
+
+#endif // PACKETQUEUE_H
@@ -0,0 +1,101 @@
+// PerformanceHud.cpp
+#include "PerformanceHud.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+// Each font pixel is drawn as a SCALE x SCALE square
+const int SCALE = 2;
+const int GLYPH_WIDTH = 3;
+const int GLYPH_HEIGHT = 5;
+const int CHAR_ADVANCE = (GLYPH_WIDTH + 1) * SCALE;
+const int LINE_HEIGHT = (GLYPH_HEIGHT + 2) * SCALE;
+const int PADDING = 6;
+
+struct Glyph {
+    char character;
+    uint8_t rows[GLYPH_HEIGHT];     // Top to bottom, leftmost pixel in bit 2
+};
+
+const Glyph FONT[] = {
+    { '0', { 7, 5, 5, 5, 7 } }, { '1', { 2, 6, 2, 2, 7 } }, { '2', { 7, 1, 7, 4, 7 } },
+    { '3', { 7, 1, 7, 1, 7 } }, { '4', { 5, 5, 7, 1, 1 } }, { '5', { 7, 4, 7, 1, 7 } },
+    { '6', { 7, 4, 7, 5, 7 } }, { '7', { 7, 1, 1, 1, 1 } }, { '8', { 7, 5, 7, 5, 7 } },
+    { '9', { 7, 5, 7, 1, 7 } },
+    { 'A', { 2, 5, 7, 5, 5 } }, { 'B', { 6, 5, 6, 5, 6 } }, { 'C', { 3, 4, 4, 4, 3 } },
+    { 'D', { 6, 5, 5, 5, 6 } }, { 'E', { 7, 4, 6, 4, 7 } }, { 'F', { 7, 4, 6, 4, 4 } },
+    { 'G', { 3, 4, 5, 5, 3 } }, { 'H', { 5, 5, 7, 5, 5 } }, { 'I', { 7, 2, 2, 2, 7 } },
+    { 'J', { 1, 1, 1, 5, 2 } }, { 'K', { 5, 5, 6, 5, 5 } }, { 'L', { 4, 4, 4, 4, 7 } },
+    { 'M', { 5, 7, 7, 5, 5 } }, { 'N', { 6, 5, 5, 5, 5 } }, { 'O', { 2, 5, 5, 5, 2 } },
+    { 'P', { 6, 5, 6, 4, 4 } }, { 'Q', { 2, 5, 5, 6, 3 } }, { 'R', { 6, 5, 6, 5, 5 } },
+    { 'S', { 3, 4, 2, 1, 6 } }, { 'T', { 7, 2, 2, 2, 2 } }, { 'U', { 5, 5, 5, 5, 7 } },
+    { 'V', { 5, 5, 5, 5, 2 } }, { 'W', { 5, 5, 7, 7, 5 } }, { 'X', { 5, 5, 2, 5, 5 } },
+    { 'Y', { 5, 5, 2, 2, 2 } }, { 'Z', { 7, 1, 2, 4, 7 } },
+    { '.', { 0, 0, 0, 0, 2 } }, { ',', { 0, 0, 0, 2, 4 } }, { ':', { 0, 2, 0, 2, 0 } },
+    { '-', { 0, 0, 7, 0, 0 } }, { '+', { 0, 2, 7, 2, 0 } }, { '/', { 1, 1, 2, 4, 4 } },
+    { '%', { 5, 1, 2, 4, 5 } }, { '(', { 1, 2, 2, 2, 1 } }, { ')', { 4, 2, 2, 2, 4 } },
+    { '=', { 0, 7, 0, 7, 0 } }, { '|', { 2, 2, 2, 2, 2 } }
+};
+}
+
+PerformanceHud::PerformanceHud()
+    : shown(false) {
+    std::fill(std::begin(glyphs), std::end(glyphs), nullptr);
+    for (const Glyph& glyph : FONT) {
+        glyphs[(int)glyph.character] = glyph.rows;
+    }
+}
+
+void PerformanceHud::draw(SDL_Renderer* renderer, int x, int y, const std::vector<std::string>& lines) {
+    size_t columns = 0;
+    for (const std::string& line : lines) {
+        columns = std::max(columns, line.size());
+    }
+
+    rects.clear();
+    for (size_t i = 0; i < lines.size(); i++) {
+        addText(lines[i], x + PADDING, y + PADDING + (int)i * LINE_HEIGHT);
+    }
+
+    // Translucent panel behind the text
+    SDL_BlendMode previousMode;
+    SDL_GetRenderDrawBlendMode(renderer, &previousMode);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 170);
+    SDL_Rect panel = { x, y, (int)columns * CHAR_ADVANCE + 2 * PADDING,
+        (int)lines.size() * LINE_HEIGHT + 2 * PADDING - 2 * SCALE };
+    SDL_RenderFillRect(renderer, &panel);
+    SDL_SetRenderDrawBlendMode(renderer, previousMode);
+
+    SDL_SetRenderDrawColor(renderer, 230, 230, 230, 255);
+    if (!rects.empty()) {
+        SDL_RenderFillRects(renderer, rects.data(), (int)rects.size());
+    }
+}
+
+void PerformanceHud::addText(const std::string& text, int x, int y) {
+    for (size_t i = 0; i < text.size(); i++) {
+        int character = std::toupper((unsigned char)text[i]);
+        const uint8_t* rows = character < 128 ? glyphs[character] : nullptr;
+        if (!rows) {
+            continue;
+        }
+
+        int left = x + (int)i * CHAR_ADVANCE;
+        for (int row = 0; row < GLYPH_HEIGHT; row++) {
+            // One rect per run of set pixels in the row
+            int column = 0;
+            while (column < GLYPH_WIDTH) {
+                if (!(rows[row] & (4 >> column))) {
+                    column++;
+                    continue;
+                }
+                int start = column;
+                while (column < GLYPH_WIDTH && (rows[row] & (4 >> column))) {
+                    column++;
+                }
+                rects.push_back({ left + start * SCALE, y + row * SCALE, (column - start) * SCALE, SCALE });
+            }
+        }
+    }
+}
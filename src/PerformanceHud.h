@@ -0,0 +1,32 @@
+// PerformanceHud.h
+#ifndef PERFORMANCEHUD_H
+#define PERFORMANCEHUD_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <SDL.h>
+
+// Text overlay drawn from a built-in 3x5 pixel font. Glyph pixels are
+// merged into horizontal runs and sent with one SDL_RenderFillRects call,
+// over one translucent panel, so a full overlay costs two draw calls.
+class PerformanceHud {
+public:
+    PerformanceHud();
+
+    void setVisible(bool visible) { shown = visible; }
+    bool isVisible() const { return shown; }
+    void toggle() { shown = !shown; }
+
+    // Lines are upper-cased; characters without a glyph are left blank
+    void draw(SDL_Renderer* renderer, int x, int y, const std::vector<std::string>& lines);
+
+private:
+    bool shown;
+    const uint8_t* glyphs[128];     // Five rows of three bits per character
+    std::vector<SDL_Rect> rects;    // Reused so drawing does not allocate
+
+    void addText(const std::string& text, int x, int y);
+};
+
+#endif // PERFORMANCEHUD_H
@@ -0,0 +1,110 @@
+// PictureQueue.cpp
+#include "PictureQueue.h"
+
+PictureQueue::PictureQueue(int maxPictures)
+    : maxPictures(maxPictures)
+    , readIndex(0)
+    , writeIndex(0)
+    , count(0)
+    , aborted(false) {
+}
+
+PictureQueue::~PictureQueue() {
+    release();
+}
+
+bool PictureQueue::init() {
+    release();
+
+    pictures.resize(maxPictures);
+    for (VideoPicture& picture : pictures) {
+        picture = VideoPicture{};
+
+        picture.frame = av_frame_alloc();
+        if (!picture.frame) {
+            release();
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    readIndex = writeIndex = count = 0;
+    aborted = false;
+    return true;
+}
+
+void PictureQueue::release() {
+    for (VideoPicture& picture : pictures) {
+        if (picture.frame) {
+            av_frame_free(&picture.frame);
+        }
+    }
+    pictures.clear();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    readIndex = writeIndex = count = 0;
+}
+
+VideoPicture* PictureQueue::peekWritable() {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return count < maxPictures || aborted; });
+
+    if (aborted || pictures.empty()) {
+        return nullptr;
+    }
+    return &pictures[writeIndex];
+}
+
+void PictureQueue::push() {
+    std::lock_guard<std::mutex> lock(mutex);
+    writeIndex = (writeIndex + 1) % maxPictures;
+    count++;
+}
+
+VideoPicture* PictureQueue::peek() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count > 0 ? &pictures[readIndex] : nullptr;
+}
+
+VideoPicture* PictureQueue::peekNext() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count > 1 ? &pictures[(readIndex + 1) % maxPictures] : nullptr;
+}
+
+void PictureQueue::pop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0) {
+        return;
+    }
+
+    av_frame_unref(pictures[readIndex].frame);
+    readIndex = (readIndex + 1) % maxPictures;
+    count--;
+    condition.notify_one();
+}
+
+void PictureQueue::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < count; i++) {
+        av_frame_unref(pictures[(readIndex + i) % maxPictures].frame);
+    }
+    readIndex = writeIndex;
+    count = 0;
+    condition.notify_one();
+}
+
+void PictureQueue::abort() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = true;
+    condition.notify_all();
+}
+
+void PictureQueue::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    aborted = false;
+}
+
+int PictureQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return count;
+}
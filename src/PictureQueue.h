@@ -0,0 +1,63 @@
+// PictureQueue.h
+#ifndef PICTUREQUEUE_H
+#define PICTUREQUEUE_H
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// Decoded picture ready for presentation
+struct VideoPicture {
+    AVFrame* frame;     // Reference to the decoded or converted image
+    double pts;         // Presentation time in seconds
+    double duration;    // Display duration in seconds
+    int serial;         // Packet serial the picture was decoded from
+    uint64_t sequence;  // Counts every picture queued, across seeks and files
+    int width;
+    int height;
+};
+
+// Fixed-size ring of decoded pictures between the video decoding thread
+// (single producer) and the render loop (single consumer). Slots only hold
+// frame references, which are dropped when a picture is popped or flushed.
+class PictureQueue {
+public:
+    explicit PictureQueue(int maxPictures = 4);
+    ~PictureQueue();
+
+    bool init();
+    void release();
+
+    // Producer side, blocks until a slot is free; nullptr once aborted
+    VideoPicture* peekWritable();
+    void push();
+
+    // Consumer side, never blocks; nullptr when nothing is queued
+    VideoPicture* peek();
+    VideoPicture* peekNext();
+    void pop();
+
+    // Drops every queued picture
+    void flush();
+    void abort();
+    void start();
+
+    int size() const;
+
+private:
+    std::vector<VideoPicture> pictures;
+    int maxPictures;
+    int readIndex;
+    int writeIndex;
+    int count;
+    bool aborted;
+
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+};
+
+#endif // PICTUREQUEUE_H
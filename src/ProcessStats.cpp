@@ -0,0 +1,164 @@
+// ProcessStats.cpp
+#include "ProcessStats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#ifdef _WIN32
+namespace {
+// FILETIME counts 100 ns units
+double fileTimeSeconds(const FILETIME& time) {
+    ULARGE_INTEGER value;
+    value.LowPart = time.dwLowDateTime;
+    value.HighPart = time.dwHighDateTime;
+    return value.QuadPart / 10000000.0;
+}
+
+double threadTimesSeconds(HANDLE thread) {
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(thread, &creation, &exit, &kernel, &user)) {
+        return 0.0;
+    }
+    return fileTimeSeconds(kernel) + fileTimeSeconds(user);
+}
+}
+#else
+namespace {
+double clockSeconds(clockid_t clock) {
+    struct timespec time;
+    if (clock_gettime(clock, &time) != 0) {
+        return 0.0;
+    }
+    return time.tv_sec + time.tv_nsec / 1000000000.0;
+}
+}
+#endif
+
+double getProcessCpuTime() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0.0;
+    }
+    return fileTimeSeconds(kernel) + fileTimeSeconds(user);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0 +
+        usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+#endif
+}
+
+double getThreadCpuTime() {
+#ifdef _WIN32
+    return threadTimesSeconds(GetCurrentThread());
+#else
+    return clockSeconds(CLOCK_THREAD_CPUTIME_ID);
+#endif
+}
+
+double getThreadCpuTime(std::thread& thread) {
+    if (!thread.joinable()) {
+        return 0.0;
+    }
+#ifdef _WIN32
+    return threadTimesSeconds((HANDLE)thread.native_handle());
+#else
+    clockid_t clock;
+    if (pthread_getcpuclockid(thread.native_handle(), &clock) != 0) {
+        return 0.0;
+    }
+    return clockSeconds(clock);
+#endif
+}
+
+size_t getPeakMemoryUsage() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return (size_t)usage.ru_maxrss * 1024; // Kilobytes on Linux
+#endif
+}
+
+namespace {
+// Off, a counted allocation costs one relaxed load
+std::atomic<bool> allocationCounting(false);
+std::atomic<uint64_t> allocationCount(0);
+std::atomic<uint64_t> allocationBytes(0);
+
+void* countedAllocate(size_t size) {
+    if (allocationCounting.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    void* memory = malloc(size > 0 ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+}
+
+void startAllocationCount() {
+    allocationCount = 0;
+    allocationBytes = 0;
+    allocationCounting = true;
+}
+
+void stopAllocationCount() {
+    allocationCounting = false;
+}
+
+AllocationCount getAllocationCount() {
+    AllocationCount count;
+    count.allocations = allocationCount.load(std::memory_order_relaxed);
+    count.bytes = allocationBytes.load(std::memory_order_relaxed);
+    return count;
+}
+
+// Every operator new of the program goes through the counter; the
+// nothrow forms fall back to these, aligned allocations are left alone
+void* operator new(size_t size) {
+    return countedAllocate(size);
+}
+
+void* operator new[](size_t size) {
+    return countedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
@@ -0,0 +1,31 @@
+// ProcessStats.h
+#ifndef PROCESSSTATS_H
+#define PROCESSSTATS_H
+
+#include <thread>
+#include <cstdint>
+
+// CPU time used by the whole process so far, user plus kernel, in seconds
+double getProcessCpuTime();
+
+// CPU time of the calling thread, or of a running thread, in seconds; 0
+// once the thread has been joined
+double getThreadCpuTime();
+double getThreadCpuTime(std::thread& thread);
+
+// Largest resident set the process has had, in bytes
+size_t getPeakMemoryUsage();
+
+// Heap allocations made through operator new, on any thread, while
+// counting is on. C allocations by FFmpeg and SDL are not seen here.
+struct AllocationCount {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+// Starts counting from zero
+void startAllocationCount();
+void stopAllocationCount();
+AllocationCount getAllocationCount();
+
+#endif // PROCESSSTATS_H
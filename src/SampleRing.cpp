@@ -0,0 +1,142 @@
+// SampleRing.cpp
+#include "SampleRing.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Every write records one segment, so this bounds the writes in flight
+const size_t SEGMENT_CAPACITY = 1024;
+}
+
+SampleRing::SampleRing()
+    : capacity(0)
+    , segmentCapacity(SEGMENT_CAPACITY)
+    , sampleRate(0)
+    , channels(0)
+    , writePosition(0)
+    , segmentWrite(0)
+    , readPosition(0)
+    , segmentRead(0) {
+}
+
+bool SampleRing::init(int rate, int channelCount, int milliseconds) {
+    if (rate <= 0 || channelCount <= 0 || milliseconds <= 0) {
+        return false;
+    }
+
+    // Round up to a power of two so positions wrap with a mask
+    size_t frames = (size_t)rate * milliseconds / 1000;
+    capacity = 1;
+    while (capacity < frames) {
+        capacity <<= 1;
+    }
+
+    sampleRate = rate;
+    channels = channelCount;
+    samples.assign(capacity * channels, 0);
+    segments.assign(segmentCapacity, Segment{ 0, 0.0, 0 });
+    clear();
+    return true;
+}
+
+void SampleRing::clear() {
+    writePosition = 0;
+    segmentWrite = 0;
+    readPosition = 0;
+    segmentRead = 0;
+}
+
+size_t SampleRing::write(const int16_t* source, size_t frames, double pts, int serial) {
+    uint64_t write = writePosition.load(std::memory_order_relaxed);
+    uint64_t read = readPosition.load(std::memory_order_acquire);
+    uint64_t segmentIndex = segmentWrite.load(std::memory_order_relaxed);
+    if (segmentIndex - segmentRead.load(std::memory_order_acquire) >= segmentCapacity) {
+        return 0;
+    }
+
+    size_t count = std::min(frames, capacity - (size_t)(write - read));
+    if (count == 0) {
+        return 0;
+    }
+
+    // Copy in up to two pieces around the end of the ring
+    size_t offset = (size_t)(write & (capacity - 1));
+    size_t first = std::min(count, capacity - offset);
+    memcpy(&samples[offset * channels], source, first * channels * sizeof(int16_t));
+    if (count > first) {
+        memcpy(&samples[0], source + first * channels, (count - first) * channels * sizeof(int16_t));
+    }
+
+    // The segment is published before the frames it describes
+    segments[segmentIndex % segmentCapacity] = Segment{ write, pts, serial };
+    segmentWrite.store(segmentIndex + 1, std::memory_order_release);
+    writePosition.store(write + count, std::memory_order_release);
+    return count;
+}
+
+size_t SampleRing::getWritableFrames() const {
+    return capacity - (size_t)(writePosition.load(std::memory_order_relaxed) -
+        readPosition.load(std::memory_order_acquire));
+}
+
+bool SampleRing::peekSegment(SampleSegment& segment) const {
+    uint64_t write = writePosition.load(std::memory_order_acquire);
+    uint64_t read = readPosition.load(std::memory_order_relaxed);
+    if (read == write) {
+        return false;
+    }
+
+    // Find the segment holding the read position and where it ends
+    uint64_t segmentEnd = segmentWrite.load(std::memory_order_acquire);
+    uint64_t index = segmentRead.load(std::memory_order_relaxed);
+    while (index + 1 < segmentEnd && segments[(index + 1) % segmentCapacity].start <= read) {
+        index++;
+    }
+
+    const Segment& current = segments[index % segmentCapacity];
+    uint64_t end = index + 1 < segmentEnd ? std::min(segments[(index + 1) % segmentCapacity].start, write) : write;
+
+    segment.pts = current.pts + (double)(read - current.start) / sampleRate;
+    segment.serial = current.serial;
+    segment.frames = (size_t)(end - read);
+    return true;
+}
+
+size_t SampleRing::read(int16_t* destination, size_t frames) {
+    uint64_t read = readPosition.load(std::memory_order_relaxed);
+    size_t count = std::min(frames, (size_t)(writePosition.load(std::memory_order_acquire) - read));
+    if (count == 0) {
+        return 0;
+    }
+
+    size_t offset = (size_t)(read & (capacity - 1));
+    size_t first = std::min(count, capacity - offset);
+    memcpy(destination, &samples[offset * channels], first * channels * sizeof(int16_t));
+    if (count > first) {
+        memcpy(destination + first * channels, &samples[0], (count - first) * channels * sizeof(int16_t));
+    }
+
+    skip(count);
+    return count;
+}
+
+void SampleRing::skip(size_t frames) {
+    uint64_t read = readPosition.load(std::memory_order_relaxed);
+    uint64_t write = writePosition.load(std::memory_order_acquire);
+    read += std::min(frames, (size_t)(write - read));
+
+    // Hand segments that were read past back to the producer
+    uint64_t segmentEnd = segmentWrite.load(std::memory_order_acquire);
+    uint64_t index = segmentRead.load(std::memory_order_relaxed);
+    while (index + 1 < segmentEnd && segments[(index + 1) % segmentCapacity].start <= read) {
+        index++;
+    }
+
+    segmentRead.store(index, std::memory_order_release);
+    readPosition.store(read, std::memory_order_release);
+}
+
+size_t SampleRing::getReadableFrames() const {
+    return (size_t)(writePosition.load(std::memory_order_acquire) -
+        readPosition.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,67 @@
+// SampleRing.h
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Where the next readable frames came from
+struct SampleSegment {
+    double pts;         // Time of the first readable frame in seconds
+    int serial;         // Packet serial the samples were decoded from
+    size_t frames;      // Readable frames left in this segment
+};
+
+// Wait-free ring of interleaved 16-bit samples between one producer (the
+// audio decoding thread) and one consumer (the audio callback). Every
+// write also records its timestamp and serial in a small side ring, so the
+// consumer knows the time of each frame it reads. Only init() allocates;
+// neither side ever locks or blocks.
+class SampleRing {
+public:
+    SampleRing();
+
+    // Sizes the ring to hold at least the given duration; not thread-safe
+    bool init(int sampleRate, int channels, int milliseconds);
+    void clear();
+
+    // Producer side; returns the frames actually written
+    size_t write(const int16_t* samples, size_t frames, double pts, int serial);
+    size_t getWritableFrames() const;
+
+    // Consumer side; peekSegment describes the frames up to the next
+    // recorded timestamp, false when the ring is empty
+    bool peekSegment(SampleSegment& segment) const;
+    size_t read(int16_t* destination, size_t frames);
+    void skip(size_t frames);
+    size_t getReadableFrames() const;
+
+    int getSampleRate() const { return sampleRate; }
+    int getChannels() const { return channels; }
+    size_t getCapacity() const { return capacity; }
+
+private:
+    struct Segment {
+        uint64_t start;     // Absolute frame position of the first frame
+        double pts;
+        int serial;
+    };
+
+    std::vector<int16_t> samples;
+    std::vector<Segment> segments;
+    size_t capacity;            // In frames, a power of two
+    size_t segmentCapacity;
+    int sampleRate;
+    int channels;
+
+    // Absolute positions, each written by one side only; kept on separate
+    // cache lines so the two threads do not share one
+    alignas(64) std::atomic<uint64_t> writePosition;
+    std::atomic<uint64_t> segmentWrite;
+    alignas(64) std::atomic<uint64_t> readPosition;
+    std::atomic<uint64_t> segmentRead;
+};
+
+#endif // SAMPLERING_H
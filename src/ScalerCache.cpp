@@ -0,0 +1,58 @@
+// ScalerCache.cpp
+#include "ScalerCache.h"
+
+ScalerCache::ScalerCache(size_t maxEntries)
+    : maxEntries(maxEntries)
+    , useCounter(0) {
+}
+
+ScalerCache::~ScalerCache() {
+    clear();
+}
+
+SwsContext* ScalerCache::get(int sourceWidth, int sourceHeight, AVPixelFormat sourceFormat,
+    int targetWidth, int targetHeight, AVPixelFormat targetFormat, int flags) {
+    useCounter++;
+
+    for (Entry& entry : entries) {
+        if (entry.sourceWidth == sourceWidth && entry.sourceHeight == sourceHeight &&
+            entry.sourceFormat == sourceFormat && entry.targetWidth == targetWidth &&
+            entry.targetHeight == targetHeight && entry.targetFormat == targetFormat &&
+            entry.flags == flags) {
+            entry.lastUsed = useCounter;
+            return entry.context;
+        }
+    }
+
+    SwsContext* context = sws_getContext(
+        sourceWidth, sourceHeight, sourceFormat,
+        targetWidth, targetHeight, targetFormat,
+        flags, nullptr, nullptr, nullptr
+    );
+    if (!context) {
+        return nullptr;
+    }
+
+    // Evict the least recently used context when full
+    if (entries.size() >= maxEntries) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < entries.size(); i++) {
+            if (entries[i].lastUsed < entries[oldest].lastUsed) {
+                oldest = i;
+            }
+        }
+        sws_freeContext(entries[oldest].context);
+        entries.erase(entries.begin() + oldest);
+    }
+
+    entries.push_back(Entry{ sourceWidth, sourceHeight, sourceFormat,
+        targetWidth, targetHeight, targetFormat, flags, context, useCounter });
+    return context;
+}
+
+void ScalerCache::clear() {
+    for (Entry& entry : entries) {
+        sws_freeContext(entry.context);
+    }
+    entries.clear();
+}
@@ -0,0 +1,44 @@
+// ScalerCache.h
+#ifndef SCALERCACHE_H
+#define SCALERCACHE_H
+
+#include <vector>
+#include <cstdint>
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+// Keeps the most recently used SwsContexts keyed by source and target size,
+// format and filter, so resizing the window back and forth reuses them
+class ScalerCache {
+public:
+    explicit ScalerCache(size_t maxEntries = 4);
+    ~ScalerCache();
+
+    // Returns a cached or newly created context, nullptr on failure
+    SwsContext* get(int sourceWidth, int sourceHeight, AVPixelFormat sourceFormat,
+        int targetWidth, int targetHeight, AVPixelFormat targetFormat, int flags);
+    void clear();
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        int sourceWidth;
+        int sourceHeight;
+        AVPixelFormat sourceFormat;
+        int targetWidth;
+        int targetHeight;
+        AVPixelFormat targetFormat;
+        int flags;
+        SwsContext* context;
+        uint64_t lastUsed;
+    };
+
+    std::vector<Entry> entries;
+    size_t maxEntries;
+    uint64_t useCounter;
+};
+
+#endif // SCALERCACHE_H
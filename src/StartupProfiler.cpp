@@ -0,0 +1,84 @@
+// StartupProfiler.cpp
+#include "StartupProfiler.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+StartupProfiler::StartupProfiler()
+    : startTime(0)
+    , active(false) {
+}
+
+void StartupProfiler::begin(const std::string& runName) {
+    std::lock_guard<std::mutex> lock(mutex);
+    name = runName;
+    startTime = now();
+    active = true;
+    marks.clear();
+}
+
+void StartupProfiler::mark(const char* phase) {
+    mark(phase, now());
+}
+
+void StartupProfiler::mark(const char* phase, int64_t timeMicros) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active) {
+        return;
+    }
+    marks.push_back({ phase, timeMicros });
+}
+
+bool StartupProfiler::hasMark(const char* phase) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Mark& entry : marks) {
+        if (strcmp(entry.phase, phase) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int64_t StartupProfiler::getStartTime() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return startTime;
+}
+
+bool StartupProfiler::isActive() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return active;
+}
+
+void StartupProfiler::report() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active) {
+        return;
+    }
+    active = false;
+
+    // Marks handed over from other threads may arrive out of order
+    std::stable_sort(marks.begin(), marks.end(), [](const Mark& a, const Mark& b) {
+        return a.time < b.time;
+    });
+
+    std::cout << "=== Startup: " << name << " ===" << std::endl;
+    int64_t previous = startTime;
+    for (const Mark& entry : marks) {
+        std::cout << "  " << std::left << std::setw(24) << entry.phase << std::right
+            << std::fixed << std::setprecision(1)
+            << std::setw(9) << (entry.time - startTime) / 1000.0 << "ms  (+"
+            << (entry.time - previous) / 1000.0 << "ms)" << std::endl;
+        previous = entry.time;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
+
+int64_t StartupProfiler::now() {
+    return av_gettime_relative();
+}
@@ -0,0 +1,48 @@
+// StartupProfiler.h
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+// Timestamps the phases from a request (initialize, open) to its first
+// visible and audible output. Marks may come from any thread; times are
+// av_gettime_relative() microseconds, so decoder threads and the audio
+// callback can record them without locking and hand them over.
+class StartupProfiler {
+public:
+    StartupProfiler();
+
+    // Starts a new run; earlier marks are dropped
+    void begin(const std::string& name);
+    // phase must be a string literal, so marking and checking for a mark
+    // do not allocate
+    void mark(const char* phase);
+    void mark(const char* phase, int64_t timeMicros);
+    bool hasMark(const char* phase) const;
+    // When the run began, in now() microseconds
+    int64_t getStartTime() const;
+
+    // Prints every phase with its time since the start and since the
+    // previous phase, then ends the run
+    void report();
+    bool isActive() const;
+
+    static int64_t now();
+
+private:
+    struct Mark {
+        const char* phase;
+        int64_t time;
+    };
+
+    mutable std::mutex mutex;
+    std::string name;
+    int64_t startTime;
+    bool active;
+    std::vector<Mark> marks;
+};
+
+#endif // STARTUPPROFILER_H
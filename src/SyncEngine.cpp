@@ -0,0 +1,239 @@
+// SyncEngine.cpp
+#include "SyncEngine.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// Drift below the threshold is left alone; the threshold follows the frame
+// duration within these bounds
+const double SYNC_THRESHOLD_MIN = 0.04;
+const double SYNC_THRESHOLD_MAX = 0.1;
+
+// Pictures longer than this are held by adding the drift instead of
+// doubling their duration
+const double FRAMEDUP_THRESHOLD = 0.1;
+
+// Gaps beyond this are discontinuities, not frame durations or drift
+const double MAX_FRAME_DURATION = 10.0;
+
+const double DEFAULT_FRAME_DURATION = 1.0 / 25.0;
+
+// Weight of the newest measurement in the smoothed drift
+const double DRIFT_SMOOTHING = 0.1;
+}
+
+SyncEngine::SyncEngine()
+    : master(SyncMaster::Audio)
+    , hasAudio(false)
+    , hasVideo(false)
+    , paused(true)
+    , firstFrame(true)
+    , frameTimer(0.0)
+    , lastPts(0.0)
+    , lastDuration(DEFAULT_FRAME_DURATION)
+    , deadline(0.0) {
+    audioClock = videoClock = externalClock = Clock{ 0.0, 0.0, true };
+    resetStats();
+}
+
+void SyncEngine::setMaster(SyncMaster newMaster) {
+    master = newMaster;
+}
+
+SyncMaster SyncEngine::getEffectiveMaster() const {
+    switch (master) {
+    case SyncMaster::Video:
+        if (hasVideo) {
+            return SyncMaster::Video;
+        }
+        return hasAudio ? SyncMaster::Audio : SyncMaster::External;
+
+    case SyncMaster::Audio:
+        return hasAudio ? SyncMaster::Audio : SyncMaster::External;
+
+    default:
+        return SyncMaster::External;
+    }
+}
+
+void SyncEngine::setStreams(bool audio, bool video) {
+    hasAudio = audio;
+    hasVideo = video;
+}
+
+void SyncEngine::reset(double pts, double now) {
+    audioClock.set(pts, now);
+    videoClock.set(pts, now);
+    externalClock.set(pts, now);
+
+    firstFrame = true;
+    frameTimer = now;
+    lastPts = pts;
+    deadline = now;
+}
+
+void SyncEngine::setPaused(bool pause, double now) {
+    if (pause == paused) {
+        return;
+    }
+
+    double pausedAt = videoClock.updated;
+    Clock* clocks[] = { &audioClock, &videoClock, &externalClock };
+    for (Clock* clock : clocks) {
+        if (pause) {
+            clock->set(clock->get(now), now);
+        }
+        else {
+            clock->updated = now;
+        }
+        clock->paused = pause;
+    }
+
+    // The picture on screen keeps the time it had left
+    if (!pause) {
+        frameTimer += now - pausedAt;
+    }
+    paused = pause;
+}
+
+void SyncEngine::updateAudioClock(double pts, double now) {
+    audioClock.set(pts, now);
+}
+
+double SyncEngine::getClock(SyncMaster clock, double now) const {
+    switch (clock) {
+    case SyncMaster::Audio: return audioClock.get(now);
+    case SyncMaster::Video: return videoClock.get(now);
+    default: return externalClock.get(now);
+    }
+}
+
+double SyncEngine::getMasterClock(double now) const {
+    return getClock(getEffectiveMaster(), now);
+}
+
+FrameAction SyncEngine::decide(double pts, double duration, double nextPts, double now) {
+    if (paused) {
+        return FrameAction::Wait;
+    }
+
+    // The first picture after a reset goes up straight away
+    if (firstFrame) {
+        firstFrame = false;
+        frameTimer = now;
+        deadline = now;
+        lastPts = pts;
+        lastDuration = duration > 0.0 ? duration : DEFAULT_FRAME_DURATION;
+        videoClock.set(pts, now);
+        stats.framesShown++;
+        return FrameAction::Show;
+    }
+
+    // The picture on screen lasts until this one's pts
+    double onScreen = pts - lastPts;
+    if (!(onScreen > 0.0 && onScreen < MAX_FRAME_DURATION)) {
+        onScreen = lastDuration;
+    }
+
+    int adjustment = 0;
+    double delay = computeDelay(onScreen, now, adjustment);
+    deadline = frameTimer + delay;
+    if (now < deadline) {
+        return FrameAction::Wait;
+    }
+
+    // After a stall the timer restarts instead of rushing through pictures
+    frameTimer = deadline;
+    if (delay > 0.0 && now - frameTimer > SYNC_THRESHOLD_MAX) {
+        frameTimer = now;
+    }
+    lastDuration = onScreen;
+    lastPts = pts;
+    updateDrift(now);
+    videoClock.set(pts, now);
+
+    if (adjustment > 0) {
+        stats.framesRepeated++;
+    }
+    else if (adjustment < 0) {
+        stats.corrections++;
+    }
+
+    // Unless video sets the pace, a picture whose successor is due as well
+    // is never shown
+    if (nextPts > pts && getEffectiveMaster() != SyncMaster::Video) {
+        double nextDuration = nextPts - pts;
+        if (nextDuration < MAX_FRAME_DURATION && now > frameTimer + nextDuration) {
+            stats.framesDropped++;
+            return FrameAction::Drop;
+        }
+    }
+
+    stats.framesShown++;
+    return FrameAction::Show;
+}
+
+double SyncEngine::computeDelay(double delay, double now, int& adjustment) {
+    adjustment = 0;
+    if (getEffectiveMaster() == SyncMaster::Video) {
+        return delay;
+    }
+
+    // Video behind the master shortens the picture on screen, video ahead
+    // holds it for longer
+    double diff = videoClock.get(now) - getMasterClock(now);
+    double threshold = std::max(SYNC_THRESHOLD_MIN, std::min(SYNC_THRESHOLD_MAX, delay));
+    if (std::fabs(diff) < MAX_FRAME_DURATION) {
+        if (diff <= -threshold) {
+            delay = std::max(0.0, delay + diff);
+            adjustment = -1;
+        }
+        else if (diff >= threshold && delay > FRAMEDUP_THRESHOLD) {
+            delay = delay + diff;
+            adjustment = 1;
+        }
+        else if (diff >= threshold) {
+            delay = 2.0 * delay;
+            adjustment = 1;
+        }
+    }
+    return delay;
+}
+
+void SyncEngine::updateDrift(double now) {
+    // With video as the master the drift is measured against audio
+    SyncMaster reference = getEffectiveMaster();
+    if (reference == SyncMaster::Video) {
+        if (!hasAudio) {
+            return;
+        }
+        reference = SyncMaster::Audio;
+    }
+
+    double diff = videoClock.get(now) - getClock(reference, now);
+    if (std::fabs(diff) >= MAX_FRAME_DURATION) {
+        return;
+    }
+    stats.drift += DRIFT_SMOOTHING * (diff - stats.drift);
+    stats.maxDrift = std::max(stats.maxDrift, std::fabs(diff));
+}
+
+double SyncEngine::getAudioDrift(double now) const {
+    if (!hasAudio || getEffectiveMaster() == SyncMaster::Audio) {
+        return 0.0;
+    }
+    return audioClock.get(now) - getMasterClock(now);
+}
+
+void SyncEngine::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+}
+
+const char* SyncEngine::getMasterName(SyncMaster clock) {
+    switch (clock) {
+    case SyncMaster::Video: return "video";
+    case SyncMaster::External: return "external";
+    default: return "audio";
+    }
+}
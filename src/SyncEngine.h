@@ -0,0 +1,104 @@
+// SyncEngine.h
+#ifndef SYNCENGINE_H
+#define SYNCENGINE_H
+
+#include <cstdint>
+
+// Which clock the others follow
+enum class SyncMaster {
+    Audio,      // Video follows the audio device
+    Video,      // Pictures keep their own pace, audio is stretched to match
+    External    // Both follow the wall clock
+};
+
+// What the renderer does with the next queued picture
+enum class FrameAction {
+    Wait,   // Not due yet, keep the current picture on screen
+    Show,   // Present it now
+    Drop    // Skip it, the picture after it is already due
+};
+
+struct SyncStats {
+    uint64_t framesShown;
+    uint64_t framesDropped;
+    uint64_t framesRepeated;    // Pictures held longer to let the master catch up
+    uint64_t corrections;       // Pictures shown early to catch up with the master
+    double drift;               // Smoothed video minus master clock, seconds
+    double maxDrift;            // Largest absolute drift seen
+};
+
+// Presentation scheduling against a selectable master clock, after
+// ffplay's frame timer: each picture is due one frame duration after the
+// previous one, stretched or shortened by how far the video clock is from
+// the master. Pure logic; every call takes the current monotonic time in
+// seconds, so it runs the same on synthetic streams as on real playback.
+class SyncEngine {
+public:
+    SyncEngine();
+
+    // Requested master; falls back to another clock if its stream is missing
+    void setMaster(SyncMaster master);
+    SyncMaster getMaster() const { return master; }
+    SyncMaster getEffectiveMaster() const;
+    void setStreams(bool hasAudio, bool hasVideo);
+
+    // Starts every clock at pts, e.g. on start or after a seek
+    void reset(double pts, double now);
+    void setPaused(bool paused, double now);
+    bool isPaused() const { return paused; }
+
+    // Position of the audio device at time now
+    void updateAudioClock(double pts, double now);
+
+    double getMasterClock(double now) const;
+    double getVideoClock(double now) const { return videoClock.get(now); }
+
+    // Decides on the oldest queued picture; nextPts is the one after it or
+    // a negative value when none is queued yet
+    FrameAction decide(double pts, double duration, double nextPts, double now);
+    // When the picture last passed to decide() is due
+    double getFrameDeadline() const { return deadline; }
+
+    // How far audio runs ahead of the master, zero when audio is the master
+    double getAudioDrift(double now) const;
+
+    const SyncStats& getStats() const { return stats; }
+    void resetStats();
+
+    static const char* getMasterName(SyncMaster master);
+
+private:
+    // A clock that runs with the monotonic time from its last update
+    struct Clock {
+        double pts;
+        double updated;
+        bool paused;
+
+        double get(double now) const { return paused ? pts : pts + (now - updated); }
+        void set(double value, double now) { pts = value; updated = now; }
+    };
+
+    SyncMaster master;
+    bool hasAudio;
+    bool hasVideo;
+    bool paused;
+
+    Clock audioClock;
+    Clock videoClock;
+    Clock externalClock;
+
+    // Frame timer state
+    bool firstFrame;
+    double frameTimer;      // When the picture on screen was due
+    double lastPts;
+    double lastDuration;
+    double deadline;
+
+    SyncStats stats;
+
+    double getClock(SyncMaster clock, double now) const;
+    double computeDelay(double delay, double now, int& adjustment);
+    void updateDrift(double now);
+};
+
+#endif // SYNCENGINE_H
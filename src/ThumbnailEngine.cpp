@@ -0,0 +1,338 @@
+// ThumbnailEngine.cpp
+#include "ThumbnailEngine.h"
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+#include <SDL.h>
+
+namespace {
+const AVPixelFormat ATLAS_FORMAT = AV_PIX_FMT_RGB24;
+const int ATLAS_BYTES_PER_PIXEL = 3;
+
+// Gives up on a target when no keyframe turns up within this many packets
+const int MAX_PACKETS_PER_THUMBNAIL = 4096;
+
+// Opens the file with its own reader; nullptr on failure
+AVFormatContext* openReader(const std::string& filename, AVIOInterruptCB interrupt, int& streamIndex) {
+    AVFormatContext* context = avformat_alloc_context();
+    if (!context) {
+        return nullptr;
+    }
+    context->interrupt_callback = interrupt;
+
+    if (avformat_open_input(&context, filename.c_str(), nullptr, nullptr) < 0) {
+        return nullptr;
+    }
+    if (avformat_find_stream_info(context, nullptr) < 0) {
+        avformat_close_input(&context);
+        return nullptr;
+    }
+
+    streamIndex = av_find_best_stream(context, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (streamIndex < 0) {
+        avformat_close_input(&context);
+        return nullptr;
+    }
+
+    for (unsigned int i = 0; i < context->nb_streams; i++) {
+        context->streams[i]->discard = (int)i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    return context;
+}
+}
+
+ThumbnailEngine::ThumbnailEngine()
+    : keyframeIndex(nullptr)
+    , atlasWidth(0)
+    , atlasHeight(0)
+    , thumbnailWidth(0)
+    , thumbnailHeight(0)
+    , busy(false)
+    , cancelled(false)
+    , nextTarget(0)
+    , completed(0)
+    , succeeded(false)
+    , elapsedSeconds(0.0) {
+}
+
+ThumbnailEngine::~ThumbnailEngine() {
+    cancel();
+}
+
+bool ThumbnailEngine::start(const std::string& file, const ThumbnailOptions& thumbnailOptions) {
+    return start(file, std::vector<double>(), thumbnailOptions);
+}
+
+bool ThumbnailEngine::start(const std::string& file, const std::vector<double>& times,
+    const ThumbnailOptions& thumbnailOptions) {
+    if (busy) {
+        return false;
+    }
+    if (coordinatorThread.joinable()) {
+        coordinatorThread.join();
+    }
+
+    filename = file;
+    options = thumbnailOptions;
+    options.count = times.empty() ? std::max(1, options.count) : (int)times.size();
+    options.width = std::max(16, options.width & ~1);
+    options.columns = std::max(1, std::min(options.columns, options.count));
+    targetTimes = times;
+
+    cancelled = false;
+    succeeded = false;
+    busy = true;
+    coordinatorThread = std::thread(&ThumbnailEngine::run, this);
+    return true;
+}
+
+bool ThumbnailEngine::wait() {
+    if (coordinatorThread.joinable()) {
+        coordinatorThread.join();
+    }
+    return succeeded;
+}
+
+void ThumbnailEngine::cancel() {
+    cancelled = true;
+    wait();
+}
+
+int ThumbnailEngine::interruptCallback(void* opaque) {
+    return static_cast<ThumbnailEngine*>(opaque)->cancelled ? 1 : 0;
+}
+
+void ThumbnailEngine::run() {
+    auto startTime = std::chrono::steady_clock::now();
+
+    if (prepare()) {
+        // Each worker opens the file itself, so seeks never contend
+        int workerCount = options.workers > 0 ? options.workers :
+            (int)std::max(1u, std::thread::hardware_concurrency());
+        workerCount = std::min(workerCount, options.count);
+
+        nextTarget = 0;
+        completed = 0;
+        std::vector<std::thread> workers;
+        for (int i = 0; i < workerCount; i++) {
+            workers.emplace_back(&ThumbnailEngine::workerLoop, this);
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << "Generated " << completed << "/" << options.count << " thumbnails with "
+            << workerCount << " workers in " << elapsedSeconds << "s" << std::endl;
+
+        bool saved = true;
+        if (!cancelled && !options.atlasPath.empty()) {
+            saved &= saveAtlas(options.atlasPath);
+        }
+        if (!cancelled && !options.imageDirectory.empty()) {
+            saved &= saveThumbnails(options.imageDirectory);
+        }
+        succeeded = !cancelled && completed > 0 && saved;
+    }
+
+    busy = false;
+}
+
+bool ThumbnailEngine::prepare() {
+    AVIOInterruptCB interrupt = { interruptCallback, this };
+    int streamIndex = -1;
+    AVFormatContext* context = openReader(filename, interrupt, streamIndex);
+    if (!context) {
+        std::cerr << "Could not open video stream for thumbnails: " << filename << std::endl;
+        return false;
+    }
+
+    AVStream* stream = context->streams[streamIndex];
+    int width = stream->codecpar->width;
+    int height = stream->codecpar->height;
+    if (width <= 0 || height <= 0) {
+        avformat_close_input(&context);
+        return false;
+    }
+
+    // Keep the display aspect ratio, including non-square pixels
+    AVRational sampleAspect = av_guess_sample_aspect_ratio(context, stream, nullptr);
+    double aspect = (double)width / height;
+    if (sampleAspect.num > 0 && sampleAspect.den > 0) {
+        aspect *= av_q2d(sampleAspect);
+    }
+    thumbnailWidth = options.width;
+    thumbnailHeight = std::max(2, (int)(thumbnailWidth / aspect + 0.5) & ~1);
+
+    // Spread the targets evenly, each in the middle of its slice
+    if (targetTimes.empty()) {
+        double start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time * av_q2d(stream->time_base) : 0.0;
+        double duration = context->duration != AV_NOPTS_VALUE ? (double)context->duration / AV_TIME_BASE : 0.0;
+        if (stream->duration != AV_NOPTS_VALUE) {
+            duration = stream->duration * av_q2d(stream->time_base);
+        }
+        for (int i = 0; i < options.count; i++) {
+            targetTimes.push_back(start + (i + 0.5) * duration / options.count);
+        }
+    }
+    avformat_close_input(&context);
+
+    int rows = (options.count + options.columns - 1) / options.columns;
+    atlasWidth = thumbnailWidth * options.columns;
+    atlasHeight = thumbnailHeight * rows;
+    atlas.assign((size_t)atlasWidth * atlasHeight * ATLAS_BYTES_PER_PIXEL, 0);
+    return true;
+}
+
+void ThumbnailEngine::workerLoop() {
+    AVIOInterruptCB interrupt = { interruptCallback, this };
+    int streamIndex = -1;
+    AVFormatContext* formatContext = openReader(filename, interrupt, streamIndex);
+    if (!formatContext) {
+        return;
+    }
+
+    AVCodecParameters* parameters = formatContext->streams[streamIndex]->codecpar;
+    const AVCodec* codec = avcodec_find_decoder(parameters->codec_id);
+    AVCodecContext* codecContext = codec ? avcodec_alloc_context3(codec) : nullptr;
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    ScalerCache scalers(2);
+
+    bool ready = codecContext && packet && frame &&
+        avcodec_parameters_to_context(codecContext, parameters) >= 0;
+    if (ready) {
+        // Workers already use every core, and only keyframes are wanted
+        codecContext->thread_count = 1;
+        codecContext->skip_frame = AVDISCARD_NONKEY;
+        codecContext->lowres = std::min(std::max(0, options.lowres), (int)codec->max_lowres);
+        ready = avcodec_open2(codecContext, codec, nullptr) >= 0;
+    }
+
+    while (ready && !cancelled) {
+        int index = nextTarget++;
+        if (index >= options.count) {
+            break;
+        }
+
+        if (decodeThumbnail(formatContext, codecContext, streamIndex, packet, frame, targetTimes[index]) &&
+            copyToAtlas(frame, index, scalers)) {
+            completed++;
+        }
+        av_frame_unref(frame);
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&codecContext);
+    avformat_close_input(&formatContext);
+}
+
+bool ThumbnailEngine::decodeThumbnail(AVFormatContext* formatContext, AVCodecContext* codecContext,
+    int streamIndex, AVPacket* packet, AVFrame* frame, double time) {
+    AVStream* stream = formatContext->streams[streamIndex];
+    int64_t target = av_rescale_q((int64_t)(time * AV_TIME_BASE), AV_TIME_BASE_Q, stream->time_base);
+
+    // The index knows exactly which keyframe opens the target's GOP
+    KeyframeEntry keyframe;
+    if (keyframeIndex && keyframeIndex->findByPts(target, keyframe)) {
+        target = keyframe.pts;
+    }
+    if (av_seek_frame(formatContext, streamIndex, target, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+    avcodec_flush_buffers(codecContext);
+
+    for (int packets = 0; packets < MAX_PACKETS_PER_THUMBNAIL && !cancelled; packets++) {
+        int ret = av_read_frame(formatContext, packet);
+        bool endOfFile = ret < 0;
+        if (!endOfFile && (packet->stream_index != streamIndex || !(packet->flags & AV_PKT_FLAG_KEY))) {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        avcodec_send_packet(codecContext, endOfFile ? nullptr : packet);
+        av_packet_unref(packet);
+
+        if (avcodec_receive_frame(codecContext, frame) == 0) {
+            return true;
+        }
+        if (endOfFile) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool ThumbnailEngine::copyToAtlas(AVFrame* frame, int index, ScalerCache& scalers) {
+    SwsContext* scaler = scalers.get(frame->width, frame->height, (AVPixelFormat)frame->format,
+        thumbnailWidth, thumbnailHeight, ATLAS_FORMAT, SWS_BILINEAR);
+    if (!scaler) {
+        return false;
+    }
+
+    // Scale straight into the thumbnail's cell
+    int stride = atlasWidth * ATLAS_BYTES_PER_PIXEL;
+    int column = index % options.columns;
+    int row = index / options.columns;
+    uint8_t* cell[4] = { atlas.data() + (size_t)row * thumbnailHeight * stride +
+        (size_t)column * thumbnailWidth * ATLAS_BYTES_PER_PIXEL, nullptr, nullptr, nullptr };
+    int cellStride[4] = { stride, 0, 0, 0 };
+
+    sws_scale(scaler, (const uint8_t* const*)frame->data, frame->linesize,
+        0, frame->height, cell, cellStride);
+    return true;
+}
+
+bool ThumbnailEngine::saveAtlas(const std::string& path) const {
+    if (atlas.empty()) {
+        return false;
+    }
+
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom((void*)atlas.data(),
+        atlasWidth, atlasHeight, 24, atlasWidth * ATLAS_BYTES_PER_PIXEL, SDL_PIXELFORMAT_RGB24);
+    if (!surface) {
+        std::cerr << "Could not create atlas surface: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    bool saved = SDL_SaveBMP(surface, path.c_str()) == 0;
+    if (!saved) {
+        std::cerr << "Could not save thumbnail atlas: " << SDL_GetError() << std::endl;
+    }
+    SDL_FreeSurface(surface);
+    return saved;
+}
+
+bool ThumbnailEngine::saveThumbnails(const std::string& directory) const {
+    if (atlas.empty()) {
+        return false;
+    }
+
+    int stride = atlasWidth * ATLAS_BYTES_PER_PIXEL;
+    for (int i = 0; i < options.count; i++) {
+        uint8_t* cell = (uint8_t*)atlas.data() + (size_t)(i / options.columns) * thumbnailHeight * stride +
+            (size_t)(i % options.columns) * thumbnailWidth * ATLAS_BYTES_PER_PIXEL;
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(cell,
+            thumbnailWidth, thumbnailHeight, 24, stride, SDL_PIXELFORMAT_RGB24);
+        if (!surface) {
+            return false;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "/thumb_%04d.bmp", i);
+        bool saved = SDL_SaveBMP(surface, (directory + name).c_str()) == 0;
+        SDL_FreeSurface(surface);
+        if (!saved) {
+            std::cerr << "Could not save thumbnail: " << SDL_GetError() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,92 @@
+// ThumbnailEngine.h
+#ifndef THUMBNAILENGINE_H
+#define THUMBNAILENGINE_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+#include "KeyframeIndex.h"
+#include "ScalerCache.h"
+
+struct ThumbnailOptions {
+    int count = 100;
+    int width = 160;            // Thumbnail width, height follows the aspect ratio
+    int columns = 10;           // Atlas layout
+    int workers = 0;            // 0 = one per core
+    int lowres = 0;             // Decoder downscale by 2^lowres where supported
+    std::string atlasPath;      // Saved as BMP when set
+    std::string imageDirectory; // One BMP per thumbnail when set
+};
+
+// Builds preview thumbnails of a file without playing it. Target times are
+// spread over a pool of workers, each with its own reader and decoder, that
+// seek to the keyframe before the target and decode only keyframes, scaling
+// them straight into their cell of one RGB24 atlas.
+class ThumbnailEngine {
+public:
+    ThumbnailEngine();
+    ~ThumbnailEngine();
+
+    // Thumbnails evenly spaced over the file, or at the given times
+    bool start(const std::string& filename, const ThumbnailOptions& options);
+    bool start(const std::string& filename, const std::vector<double>& times,
+        const ThumbnailOptions& options);
+    bool wait();
+    void cancel();
+    bool isBusy() const { return busy; }
+
+    // Seeks go straight to indexed keyframes; the index must outlive the run
+    void setKeyframeIndex(const KeyframeIndex* index) { keyframeIndex = index; }
+
+    // Results, valid once finished
+    const std::vector<uint8_t>& getAtlas() const { return atlas; }
+    int getAtlasWidth() const { return atlasWidth; }
+    int getAtlasHeight() const { return atlasHeight; }
+    int getThumbnailWidth() const { return thumbnailWidth; }
+    int getThumbnailHeight() const { return thumbnailHeight; }
+    int getCompletedCount() const { return completed; }
+    double getElapsedSeconds() const { return elapsedSeconds; }
+
+    bool saveAtlas(const std::string& path) const;
+    bool saveThumbnails(const std::string& directory) const;
+
+private:
+    std::string filename;
+    ThumbnailOptions options;
+    std::vector<double> targetTimes;
+    const KeyframeIndex* keyframeIndex;
+
+    // Atlas cells are disjoint, so workers write without locking
+    std::vector<uint8_t> atlas;
+    int atlasWidth;
+    int atlasHeight;
+    int thumbnailWidth;
+    int thumbnailHeight;
+
+    std::thread coordinatorThread;
+    std::atomic<bool> busy;
+    std::atomic<bool> cancelled;
+    std::atomic<int> nextTarget;
+    std::atomic<int> completed;
+    std::atomic<bool> succeeded;
+    double elapsedSeconds;
+
+    void run();
+    bool prepare();
+    void workerLoop();
+    bool decodeThumbnail(AVFormatContext* formatContext, AVCodecContext* codecContext,
+        int streamIndex, AVPacket* packet, AVFrame* frame, double time);
+    bool copyToAtlas(AVFrame* frame, int index, ScalerCache& scalers);
+    static int interruptCallback(void* opaque);
+};
+
+#endif // THUMBNAILENGINE_H
@@ -0,0 +1,240 @@
+// Tracer.cpp
+#include "Tracer.h"
+
+#if MEDIAPLAYER_TRACING
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+namespace {
+// Per thread; about 2.5 MB each, several minutes of playback at the rate
+// the demux thread produces spans. Later spans are counted and dropped.
+const size_t EVENTS_PER_THREAD = 1 << 16;
+
+struct TraceEvent {
+    const char* name;
+    int64_t start;
+    int64_t duration;   // < 0 for instant marks
+    uint64_t sequence;  // 0 if the event belongs to no picture
+    double pts;
+};
+
+struct ThreadBuffer {
+    std::string name;
+    int id = 0;
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<size_t> count{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+};
+
+// Buffers outlive their threads so they can be written at exit
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    int64_t origin = 0;
+};
+
+TraceRegistry& getRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+thread_local ThreadBuffer* threadBuffer = nullptr;
+thread_local const char* threadName = nullptr;
+
+// The first event of a thread allocates its buffer, everything after is
+// lock-free
+ThreadBuffer* getThreadBuffer() {
+    if (!threadBuffer) {
+        TraceRegistry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->id = (int)registry.buffers.size() + 1;
+        buffer->name = "thread " + std::to_string(buffer->id);
+        buffer->events.reset(new TraceEvent[EVENTS_PER_THREAD]);
+        threadBuffer = buffer.get();
+        registry.buffers.push_back(std::move(buffer));
+    }
+    return threadBuffer;
+}
+
+void append(const char* name, int64_t start, int64_t duration, uint64_t sequence, double pts) {
+    ThreadBuffer* buffer = getThreadBuffer();
+    size_t count = buffer->count.load(std::memory_order_relaxed);
+    if (count >= EVENTS_PER_THREAD) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer->events[count] = { name, start, duration, sequence, pts };
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+// Per picture timings gathered from the spans that carry its sequence
+struct PictureRow {
+    double pts = 0.0;
+    int64_t queued = -1;
+    int64_t convert = 0;
+    int64_t upload = 0;
+    int64_t present = 0;
+    int64_t shown = -1;
+};
+
+void addToRow(PictureRow& row, const TraceEvent& event) {
+    std::string name = event.name;
+    if (name == "queued" && row.queued < 0) {
+        row.queued = event.start;
+    }
+    else if (name == "convert") {
+        row.convert += event.duration;
+    }
+    else if (name == "upload") {
+        row.upload += event.duration;
+    }
+    else if (name == "present") {
+        row.present += event.duration;
+        if (row.shown < 0) {
+            row.shown = event.start + event.duration;
+        }
+    }
+}
+}
+
+std::atomic<bool> Tracer::recording(false);
+
+void Tracer::start() {
+    getRegistry().origin = now();
+    recording = true;
+    std::cout << "Tracing started" << std::endl;
+}
+
+void Tracer::stop() {
+    recording = false;
+}
+
+int64_t Tracer::now() {
+    return av_gettime_relative();
+}
+
+void Tracer::setThreadName(const char* name) {
+    // Cheap enough to call from a callback that runs over and over
+    if (threadName == name) {
+        return;
+    }
+    threadName = name;
+
+    ThreadBuffer* buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(getRegistry().mutex);
+    buffer->name = name;
+}
+
+void Tracer::record(const char* name, int64_t start, int64_t end, uint64_t sequence, double pts) {
+    append(name, start, end - start, sequence, pts);
+}
+
+void Tracer::mark(const char* name, uint64_t sequence, double pts) {
+    if (isRecording()) {
+        append(name, now(), -1, sequence, pts);
+    }
+}
+
+bool Tracer::write(const std::string& jsonPath, const std::string& csvPath) {
+    stop();
+
+    TraceRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::ofstream json(jsonPath);
+    if (!json) {
+        std::cerr << "Failed to write trace: " << jsonPath << std::endl;
+        return false;
+    }
+
+    std::map<uint64_t, PictureRow> pictures;
+    size_t total = 0;
+    uint64_t dropped = 0;
+    bool first = true;
+
+    json << std::fixed << std::setprecision(3);
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (const auto& buffer : registry.buffers) {
+        json << (first ? "\n" : ",\n");
+        first = false;
+        json << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+            << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+
+        // Events before the published count are complete
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent& event = buffer->events[i];
+            json << ",\n{\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << buffer->id
+                << ",\"ts\":" << (event.start - registry.origin);
+            if (event.duration >= 0) {
+                json << ",\"ph\":\"X\",\"dur\":" << event.duration;
+            }
+            else {
+                json << ",\"ph\":\"i\",\"s\":\"t\"";
+            }
+            if (event.sequence > 0) {
+                json << ",\"args\":{\"picture\":" << event.sequence << ",\"pts\":" << event.pts << "}";
+            }
+            json << "}";
+
+            if (event.sequence > 0) {
+                PictureRow& row = pictures[event.sequence];
+                row.pts = event.pts;
+                addToRow(row, event);
+            }
+        }
+
+        total += count;
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    json << "\n]}\n";
+
+    std::ofstream csv(csvPath);
+    if (!csv) {
+        std::cerr << "Failed to write frame timings: " << csvPath << std::endl;
+        return false;
+    }
+
+    // Times in milliseconds since tracing started, durations in microseconds
+    csv << std::fixed << std::setprecision(3);
+    csv << "picture,pts,queued_ms,convert_us,upload_us,present_us,shown_ms,latency_ms\n";
+    for (const auto& entry : pictures) {
+        const PictureRow& row = entry.second;
+        csv << entry.first << "," << row.pts << ",";
+        if (row.queued >= 0) {
+            csv << (row.queued - registry.origin) / 1000.0;
+        }
+        csv << "," << row.convert << "," << row.upload << "," << row.present << ",";
+        if (row.shown >= 0) {
+            csv << (row.shown - registry.origin) / 1000.0;
+        }
+        csv << ",";
+        if (row.queued >= 0 && row.shown >= 0) {
+            csv << (row.shown - row.queued) / 1000.0;
+        }
+        csv << "\n";
+    }
+
+    std::cout << "Trace: " << total << " events on " << registry.buffers.size() << " threads written to "
+        << jsonPath << ", " << pictures.size() << " pictures to " << csvPath;
+    if (dropped > 0) {
+        std::cout << " (" << dropped << " events dropped, buffers full)";
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+#endif // MEDIAPLAYER_TRACING
@@ -0,0 +1,95 @@
+// Tracer.h
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <cstdint>
+#include <string>
+
+// Built in with -DMEDIAPLAYER_TRACING=ON. Without it every TRACE_ macro
+// expands to nothing, so the decode loops and the audio callback carry no
+// instrumentation at all.
+#ifndef MEDIAPLAYER_TRACING
+#define MEDIAPLAYER_TRACING 0
+#endif
+
+#if MEDIAPLAYER_TRACING
+
+#include <atomic>
+
+// Records timestamped spans into one fixed buffer per thread. Only the
+// owning thread writes to its buffer and publishes the event count, so a
+// span costs two clock reads and a store; the buffers are read when the
+// trace is written, as Chrome trace_event JSON (chrome://tracing,
+// ui.perfetto.dev) and as one CSV row per video picture.
+class Tracer {
+public:
+    // Starts recording; spans before this are not kept
+    static void start();
+    static void stop();
+    static bool isRecording() { return recording.load(std::memory_order_relaxed); }
+
+    // Microseconds on the same clock as av_gettime_relative()
+    static int64_t now();
+
+    // Names the calling thread in the trace; name must be a string literal
+    static void setThreadName(const char* name);
+
+    // name must be a string literal. Pictures are keyed by the sequence
+    // number the decoder gave them, 0 when the span belongs to no picture;
+    // the pts in seconds is carried along for reading the trace.
+    static void record(const char* name, int64_t start, int64_t end, uint64_t sequence, double pts);
+    static void mark(const char* name, uint64_t sequence, double pts);
+
+    static bool write(const std::string& jsonPath, const std::string& csvPath);
+
+private:
+    static std::atomic<bool> recording;
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, uint64_t sequence = 0, double pts = -1.0)
+        : name(name)
+        , sequence(sequence)
+        , pts(pts)
+        , start(Tracer::isRecording() ? Tracer::now() : -1) {
+    }
+
+    ~TraceScope() {
+        if (start >= 0) {
+            Tracer::record(name, start, Tracer::now(), sequence, pts);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t sequence;
+    double pts;
+    int64_t start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_PICTURE(name, sequence, pts) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, sequence, pts)
+#define TRACE_MARK_PICTURE(name, sequence, pts) Tracer::mark(name, sequence, pts)
+#define TRACE_THREAD_NAME(name) Tracer::setThreadName(name)
+#define TRACE_START() Tracer::start()
+#define TRACE_WRITE(jsonPath, csvPath) Tracer::write(jsonPath, csvPath)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_PICTURE(name, sequence, pts) ((void)0)
+#define TRACE_MARK_PICTURE(name, sequence, pts) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#define TRACE_START() ((void)0)
+#define TRACE_WRITE(jsonPath, csvPath) ((void)0)
+
+#endif // MEDIAPLAYER_TRACING
+
+#endif // TRACER_H
@@ -1,24 +1,77 @@
 #include "VideoDecoder.h"
+#include "Tracer.h"
+#include "Logger.h"
+#include "ProcessStats.h"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <cfloat>
+
+namespace {
+// How long the decoding thread waits for a packet before rechecking state
+const int PACKET_WAIT_MS = 20;
+
+// FFmpeg's own ceiling for automatically chosen decoder threads
+const int MAX_DECODER_THREADS = 16;
+
+void printPoolStats(const char* name, const FramePoolStats& stats) {
+	if (stats.requests == 0) {
+		return;
+	}
+	std::cout << name << " pool: " << stats.requests - stats.misses << " hits, "
+		<< stats.misses << " misses, peak " << stats.peakBytes / 1024 << " KiB" << std::endl;
+}
+
+void printLatenessStats(const LatenessStats& stats) {
+	if (stats.framesDropped == 0 && stats.stageEntries[(int)LateStage::DropFrames] == 0) {
+		return;
+	}
+	std::cout << "Late frames: " << stats.framesDropped << " of " << stats.framesChecked << " dropped" << std::endl;
+	for (int i = 1; i < (int)LateStage::Count; i++) {
+		std::cout << "  " << LatenessController::getStageName((LateStage)i) << ": entered "
+			<< stats.stageEntries[i] << "x, " << stats.framesInStage[i] << " frames" << std::endl;
+	}
+}
+}
 
 VideoDecoder::VideoDecoder()
-	: formatContext(nullptr)
+	: demuxer(nullptr)
+	, packetQueue(nullptr)
+	, videoStream(nullptr)
 	, videoCodecContext(nullptr)
 	, videoCodec(nullptr)
 	, frame(nullptr)
-	, frameRGB(nullptr)
 	, packet(nullptr)
-	, swsContext(nullptr)
-	, videoStreamIndex(-1)
+	, packetSerial(-1)
 	, frameWidth(0)
 	, frameHeight(0)
 	, pixelFormat(AV_PIX_FMT_NONE)
-	, buffer(nullptr)
-	, bufferSize(0)
+	, nativeOutput(true)
+	, outputFormat(AV_PIX_FMT_NONE)
+	, targetWidth(0)
+	, targetHeight(0)
+	, scaleFilter(ScaleFilter::Bilinear)
+	, simdConversion(true)
+	, bitexact(false)
+	, threadingPolicy(ThreadingPolicy::Auto)
+	, requestedThreads(0)
 	, timeBase(0.0)
 	, frameRate(0.0)
 	, duration(0)
+	, nextPts(0.0)
+	, currentPts(0.0)
+	, seekTarget(-DBL_MAX)
+	, firstPictureTime(-1)
+	, pictureSequence(0)
+	, framesDecoded(0)
+	, framesConverted(0)
+	, conversionMicros(0)
+	, masterClock(0.0)
+	, masterClockUpdated(0)
+	, masterClockRunning(false)
+	, latenessReset(false)
+	, appliedStage(LateStage::None)
+	, shouldStop(false)
 	, isOpen(false)
 	, endOfStream(false) {
 }
@@ -27,32 +80,13 @@ VideoDecoder::~VideoDecoder() {
 	close();
 }
 
-bool VideoDecoder::OpenFile(const std::string& filename) {
-	std::cout << "Opening video file: " << filename << std::endl;
+bool VideoDecoder::OpenStream(Demuxer& source) {
+	std::cout << "Opening video stream" << std::endl;
 
 	// Clean up any exsiting state
 	close();
 
-	// Allocate format context
-	formatContext = avformat_alloc_context();
-	if (!formatContext) {
-		std::cerr << "Could not allocate format context" << std::endl;
-		return false;
-	}
-
-	// Opening input file
-	if (avformat_open_input(&formatContext, filename.c_str(), nullptr, nullptr) < 0) {
-		std::cerr << "Could not open input file: " << filename << std::endl;
-		cleanup();
-		return false;
-	}
-
-	// Retrieve stream information
-	if (avformat_find_stream_info(formatContext, nullptr) < 0) {
-		std::cerr << "Could not find stream information" << std::endl;
-		cleanup();
-		return false;
-	}
+	demuxer = &source;
 
 	// Find video stream
 	if (!findVideoStream()) {
@@ -78,31 +112,47 @@ bool VideoDecoder::OpenFile(const std::string& filename) {
 	// Calculate timing information
 	calculateTiming();
 
-	// Allocate frames and packet
+	// Allocate frame and packet
 	frame = av_frame_alloc();
-	frameRGB = av_frame_alloc();
 	packet = av_packet_alloc();
 
-	if (!frame || !frameRGB || !packet) {
-		std::cerr << "Could not allocate frames/packet" << std::endl;
+	if (!frame || !packet) {
+		std::cerr << "Could not allocate frame/packet" << std::endl;
 		cleanup();
 		return false;
 	}
 
-	// Allocate RGB buffer
-	bufferSize = av_image_get_buffer_size(AV_PIX_FMT_RGB24, frameWidth, frameHeight, 1);
-	buffer = (uint8_t*)av_malloc(bufferSize);
-	if (!buffer) {
-		std::cerr << "Could not allocate RGB buffer" << std::endl;
+	// Allocate the picture ring; pictures reference pooled buffers
+	if (!pictureQueue.init()) {
+		std::cerr << "Could not allocate picture queue" << std::endl;
 		cleanup();
 		return false;
 	}
 
-	// Setup RGB frame
-	av_image_fill_arrays(frameRGB->data, frameRGB->linesize, buffer, AV_PIX_FMT_RGB24, frameWidth, frameHeight, 1);
+	// Start receiving packets from the shared demuxer
+	packetQueue = demuxer->attachStream(AVMEDIA_TYPE_VIDEO);
+	if (!packetQueue) {
+		std::cerr << "Could not attach to video packet queue" << std::endl;
+		cleanup();
+		return false;
+	}
 
 	isOpen = true;
 	endOfStream = false;
+	nextPts = 0.0;
+	currentPts = 0.0;
+	seekTarget = -DBL_MAX;
+	firstPictureTime = -1;
+	framesDecoded = 0;
+	framesConverted = 0;
+	conversionMicros = 0;
+	masterClockRunning = false;
+	appliedStage = LateStage::None;
+	latenessController = LatenessController();
+
+	// Start decoding ahead into the picture queue
+	shouldStop = false;
+	decoderThread = std::thread(&VideoDecoder::decodingLoop, this);
 
 	std::cout << "Video file opened successfully!" << std::endl;
 	printFileInfo();
@@ -111,21 +161,12 @@ bool VideoDecoder::OpenFile(const std::string& filename) {
 }
 
 bool VideoDecoder::findVideoStream() {
-	videoStreamIndex = -1;
-
-	for (unsigned int i = 0; i < formatContext->nb_streams; i++) {
-		if (formatContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-			videoStreamIndex = i;
-			break;
-		}
-	}
-
-	if (videoStreamIndex == -1) {
+	videoStream = demuxer->getStream(AVMEDIA_TYPE_VIDEO);
+	if (!videoStream) {
 		return false;
 	}
 
 	// Get stream parameters
-	AVStream* videoStream = formatContext->streams[videoStreamIndex];
 	frameWidth = videoStream->codecpar->width;
 	frameHeight = videoStream->codecpar->height;
 	pixelFormat = (AVPixelFormat)videoStream->codecpar->format;
@@ -135,7 +176,7 @@ bool VideoDecoder::findVideoStream() {
 
 bool VideoDecoder::setupDecoder() {
 	// Get codec parameters
-	AVCodecParameters* codecParams = formatContext->streams[videoStreamIndex]->codecpar;
+	AVCodecParameters* codecParams = videoStream->codecpar;
 
 	// Find decoder
 	videoCodec = avcodec_find_decoder(codecParams->codec_id);
@@ -157,6 +198,19 @@ bool VideoDecoder::setupDecoder() {
 		return false;
 	}
 
+	// Spread decoding across cores
+	configureThreading();
+
+	if (bitexact) {
+		videoCodecContext->flags |= AV_CODEC_FLAG_BITEXACT;
+	}
+
+	// Let the codec decode into recycled buffers where it supports that
+	if (videoCodec->capabilities & AV_CODEC_CAP_DR1) {
+		videoCodecContext->opaque = &decodePool;
+		videoCodecContext->get_buffer2 = FramePool::getCodecBuffer;
+	}
+
 	// Opend codec 
 	if (avcodec_open2(videoCodecContext, videoCodec, nullptr) < 0) {
 		std::cerr << "Could not open codec" << std::endl;
@@ -166,15 +220,112 @@ bool VideoDecoder::setupDecoder() {
 	return true;
 }
 
+void VideoDecoder::setThreadingPolicy(ThreadingPolicy policy, int threads) {
+	threadingPolicy = policy;
+	requestedThreads = std::max(0, threads);
+}
+
+const char* VideoDecoder::getThreadingPolicyName(ThreadingPolicy policy) {
+	switch (policy) {
+	case ThreadingPolicy::Frame: return "frame";
+	case ThreadingPolicy::Slice: return "slice";
+	case ThreadingPolicy::Count: return "count";
+	default: return "auto";
+	}
+}
+
+bool VideoDecoder::parseThreadingPolicy(const std::string& name, ThreadingPolicy& policy) {
+	const ThreadingPolicy policies[] = { ThreadingPolicy::Auto, ThreadingPolicy::Frame, ThreadingPolicy::Slice, ThreadingPolicy::Count };
+	for (ThreadingPolicy candidate : policies) {
+		if (name == getThreadingPolicyName(candidate)) {
+			policy = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+void VideoDecoder::configureThreading() {
+	int cores = (int)std::max(1u, std::thread::hardware_concurrency());
+	int threads = requestedThreads > 0 ? requestedThreads : cores;
+
+	switch (threadingPolicy) {
+	case ThreadingPolicy::Frame:
+		videoCodecContext->thread_type = FF_THREAD_FRAME;
+		break;
+
+	case ThreadingPolicy::Slice:
+		videoCodecContext->thread_type = FF_THREAD_SLICE;
+		break;
+
+	case ThreadingPolicy::Count:
+		videoCodecContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+		break;
+
+	case ThreadingPolicy::Auto:
+	default:
+		// Frame threading adds a frame of latency per thread, so only
+		// large pictures get every core
+		if (requestedThreads == 0) {
+			int pixels = frameWidth * frameHeight;
+			if (pixels < 1280 * 720) {
+				threads = std::min(threads, 4);
+			}
+			else if (pixels < 1920 * 1080) {
+				threads = std::min(threads, 8);
+			}
+			threads = std::min(threads, MAX_DECODER_THREADS);
+		}
+
+		// Prefer frame threads, add slice threads where the codec has them
+		videoCodecContext->thread_type = 0;
+		if (videoCodec->capabilities & AV_CODEC_CAP_FRAME_THREADS) {
+			videoCodecContext->thread_type |= FF_THREAD_FRAME;
+		}
+		if (videoCodec->capabilities & AV_CODEC_CAP_SLICE_THREADS) {
+			videoCodecContext->thread_type |= FF_THREAD_SLICE;
+		}
+		if (videoCodecContext->thread_type == 0 &&
+			!(videoCodec->capabilities & AV_CODEC_CAP_OTHER_THREADS)) {
+			threads = 1;
+		}
+		break;
+	}
+
+	videoCodecContext->thread_count = threads;
+}
+
 bool VideoDecoder::setupScaler() {
-	// Create scaling context
-	swsContext = sws_getContext(
-		frameWidth, frameHeight, pixelFormat,
-		frameWidth, frameHeight, AV_PIX_FMT_RGB24,
-		SWS_BILINEAR, nullptr, nullptr, nullptr
-	);
+	// Formats the renderer can upload directly need no conversion
+	outputFormat = AV_PIX_FMT_RGB24;
+	if (nativeOutput) {
+		switch (pixelFormat) {
+		case AV_PIX_FMT_YUV420P:
+		case AV_PIX_FMT_YUVJ420P:
+		case AV_PIX_FMT_NV12:
+		case AV_PIX_FMT_NV21:
+			outputFormat = pixelFormat;
+			return true;
+		default:
+			break;
+		}
+	}
 
-	if (!swsContext) {
+	// Same-size YUV to RGB runs on the built-in SIMD kernels
+	if (simdConversion && ColorConverter::isSupported(pixelFormat, outputFormat)) {
+		AVColorSpace colorSpace = getColorSpace();
+		bool bt709 = colorSpace == AVCOL_SPC_BT709 ||
+			(colorSpace == AVCOL_SPC_UNSPECIFIED && frameHeight >= 720);
+		if (colorConverter.configure(pixelFormat, outputFormat, frameWidth,
+			bt709 ? YuvMatrix::BT709 : YuvMatrix::BT601,
+			isFullRange() ? YuvRange::Full : YuvRange::Limited)) {
+			return true;
+		}
+	}
+
+	// Create scaling context
+	if (!scalerCache.get(frameWidth, frameHeight, pixelFormat,
+		frameWidth, frameHeight, outputFormat, getScaleFlags())) {
 		std::cerr << "Could not create scaling context" << std::endl;
 		return false;
 	}
@@ -182,8 +333,51 @@ bool VideoDecoder::setupScaler() {
 	return true;
 }
 
+void VideoDecoder::setOutputSize(int width, int height) {
+	std::lock_guard<std::mutex> lock(outputMutex);
+	targetWidth = std::max(0, width);
+	targetHeight = std::max(0, height);
+}
+
+void VideoDecoder::getOutputSize(int& width, int& height) {
+	{
+		std::lock_guard<std::mutex> lock(outputMutex);
+		width = targetWidth;
+		height = targetHeight;
+	}
+
+	// Only ever scale down
+	if (width <= 0 || height <= 0 || width >= frameWidth || height >= frameHeight) {
+		width = frameWidth;
+		height = frameHeight;
+		return;
+	}
+
+	// Subsampled chroma needs even dimensions
+	if (outputFormat != AV_PIX_FMT_RGB24) {
+		width = std::max(2, width & ~1);
+		height = std::max(2, height & ~1);
+	}
+}
+
+int VideoDecoder::getScaleFlags() const {
+	int flags;
+	switch (scaleFilter.load()) {
+	case ScaleFilter::Fast: flags = SWS_FAST_BILINEAR; break;
+	case ScaleFilter::Bicubic: flags = SWS_BICUBIC; break;
+	case ScaleFilter::Lanczos: flags = SWS_LANCZOS; break;
+	default: flags = SWS_BILINEAR; break;
+	}
+
+	// Without these swscale output may differ between CPUs
+	if (bitexact) {
+		flags |= SWS_BITEXACT | SWS_ACCURATE_RND;
+	}
+	return flags;
+}
+
 void VideoDecoder::calculateTiming() {
-	AVStream* videoStream = formatContext->streams[videoStreamIndex];
+	AVFormatContext* formatContext = demuxer->getFormatContext();
 
 	// Time base
 	timeBase = av_q2d(videoStream->time_base);
@@ -199,88 +393,302 @@ void VideoDecoder::calculateTiming() {
 	}
 }
 
-bool VideoDecoder::getNextFrame(uint8_t** rgbData, int& width, int& height) {
-	if (!isOpen || endOfStream) {
-		return false;
-	}
-
-	while (true) {
-		// Read packet
-		int ret = av_read_frame(formatContext, packet);
-		if (ret < 0) {
-			if (ret == AVERROR_EOF) {
-				endOfStream = true;
-				std::cout << "End of stream reached" << std::endl;
+void VideoDecoder::decodingLoop() {
+	std::cout << "Video decoding thread started" << std::endl;
+	TRACE_THREAD_NAME("video decode");
+
+	while (!shouldStop) {
+		// Hand out any frame the decoder already has
+		int ret = avcodec_receive_frame(videoCodecContext, frame);
+		if (ret == 0) {
+			bool queued = queuePicture(frame);
+			av_frame_unref(frame);
+			if (!queued) {
+				break; // Picture queue aborted
 			}
-			else {
-				std::cerr << "Error reading frame: " << ret << std::endl;
+			continue;
+		}
+		if (ret == AVERROR_EOF) {
+			if (!endOfStream) {
+				endOfStream = true;
+				LOG_INFO("End of stream reached");
 			}
-			return false;
 		}
-
-		// Check if packet belongs to video stream
-		if (packet->stream_index != videoStreamIndex) {
-			av_packet_unref(packet);
-			continue;
+		else if (ret != AVERROR(EAGAIN)) {
+			LOG_ERROR("Error receiving frame: %d", ret);
 		}
 
-		// Send packet to decoder
-		ret = avcodec_send_packet(videoCodecContext, packet);
+		// Decoder needs more input, take the next packet from the demuxer
+		int serial = 0;
+		ret = packetQueue->get(packet, &serial, PACKET_WAIT_MS);
 		if (ret < 0) {
-			std::cerr << "Error sending packet to decoder: " << ret << std::endl;
-			av_packet_unref(packet);
+			break; // Packet queue aborted
+		}
+		if (ret == 0) {
 			continue;
 		}
 
-		// Receive frame from decoder
-		ret = avcodec_receive_frame(videoCodecContext, frame);
-		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-			av_packet_unref(packet);
-			continue;
+		// Packets after a seek start a new serial, drop the old codec state
+		if (serial != packetSerial) {
+			avcodec_flush_buffers(videoCodecContext);
+			packetSerial = serial;
+			endOfStream = false;
+		}
+
+		// An empty packet marks the end of the stream, drain the decoder
+		bool drain = !packet->data && packet->size == 0;
+		{
+			TRACE_SCOPE("decode");
+			ret = avcodec_send_packet(videoCodecContext, drain ? nullptr : packet);
 		}
+		if (ret < 0 && ret != AVERROR_EOF) {
+			LOG_ERROR("Error sending packet to decoder: %d", ret);
+		}
+		av_packet_unref(packet);
+	}
 
-		// Convert frame to RGB
-		sws_scale(swsContext,
-				(const uint8_t* const*)frame->data, frame->linesize,
-				0, frameHeight,
-				frameRGB->data, frameRGB->linesize);
+	std::cout << "Video decoding thread ended" << std::endl;
+}
 
-		// Set output parameters
-		*rgbData = frameRGB->data[0];
-		width = frameWidth;
-		height = frameHeight;
+bool VideoDecoder::queuePicture(AVFrame* decoded) {
+	framesDecoded++;
 
-		av_packet_unref(packet);
+	// Stamp with presentation time, guessing when the stream has none
+	double frameDuration = frameRate > 0.0 ? 1.0 / frameRate : 0.0;
+	int64_t timestamp = decoded->best_effort_timestamp;
+	double pts = timestamp != AV_NOPTS_VALUE ? timestamp * timeBase : nextPts;
+	nextPts = pts + frameDuration;
+
+	// After a seek the GOP is decoded from its keyframe, but only the
+	// pictures from the seek target on are shown
+	if (pts + frameDuration * 0.5 < seekTarget) {
+		return true;
+	}
+
+	// Frames that are already late are not worth converting
+	if (checkLateness(pts, frameDuration)) {
 		return true;
 	}
+
+	// Wait for a free slot in the picture ring
+	VideoPicture* picture = pictureQueue.peekWritable();
+	if (!picture) {
+		return false;
+	}
+
+	// The pts can repeat after a seek or a loop; the sequence tells the
+	// pictures apart in the trace
+	uint64_t sequence = ++pictureSequence;
+
+	// Native frames shown at full size are handed over by reference,
+	// everything else is converted straight to the displayed size
+	int width, height;
+	getOutputSize(width, height);
+	if (outputFormat == pixelFormat && decoded->format == outputFormat &&
+		decoded->width == width && decoded->height == height) {
+		av_frame_move_ref(picture->frame, decoded);
+	}
+	else {
+		TRACE_SCOPE_PICTURE("convert", sequence, pts);
+		int64_t started = av_gettime_relative();
+		if (!convertPicture(decoded, picture, width, height)) {
+			return true; // Drop the frame, keep decoding
+		}
+		conversionMicros += av_gettime_relative() - started;
+		framesConverted++;
+	}
+
+	picture->pts = pts;
+	picture->duration = frameDuration;
+	picture->serial = packetSerial;
+	picture->sequence = sequence;
+	picture->width = picture->frame->width;
+	picture->height = picture->frame->height;
+
+	pictureQueue.push();
+	TRACE_MARK_PICTURE("queued", sequence, pts);
+	if (firstPictureTime < 0) {
+		firstPictureTime = av_gettime_relative();
+	}
+	return true;
 }
 
-bool VideoDecoder::seekToTime(double seconds) {
-	if (!isOpen) {
+bool VideoDecoder::checkLateness(double pts, double frameDuration) {
+	std::lock_guard<std::mutex> lock(latenessMutex);
+
+	// A seek makes the lateness so far meaningless
+	if (latenessReset.exchange(false)) {
+		latenessController.reset();
+		applyLateStage(LateStage::None);
+	}
+
+	if (!masterClockRunning) {
 		return false;
 	}
 
-	int64_t timestamp = (int64_t)(seconds / timeBase);
+	int64_t now = av_gettime_relative();
+	double clock = masterClock + (now - masterClockUpdated) / 1000000.0;
+	bool drop = latenessController.update(clock - pts, frameDuration, now / 1000000.0);
+	applyLateStage(latenessController.getStage());
+	return drop;
+}
+
+void VideoDecoder::applyLateStage(LateStage stage) {
+	if (stage == appliedStage) {
+		return;
+	}
+
+	// The codec picks these up with the next packet
+	videoCodecContext->skip_loop_filter = stage >= LateStage::SkipLoopFilter ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+	if (stage >= LateStage::KeyframesOnly) {
+		videoCodecContext->skip_frame = AVDISCARD_NONKEY;
+	}
+	else if (stage >= LateStage::SkipNonRef) {
+		videoCodecContext->skip_frame = AVDISCARD_NONREF;
+	}
+	else {
+		videoCodecContext->skip_frame = AVDISCARD_DEFAULT;
+	}
+
+	LOG_INFO("Video decoding %s, late stage: %s", stage > appliedStage ? "behind" : "catching up",
+		LatenessController::getStageName(stage));
+	appliedStage = stage;
+}
+
+void VideoDecoder::updateMasterClock(double seconds, bool running) {
+	masterClock = seconds;
+	masterClockUpdated = av_gettime_relative();
+	masterClockRunning = running;
+}
+
+VideoDecodeStats VideoDecoder::getDecodeStats() const {
+	VideoDecodeStats stats;
+	stats.framesDecoded = framesDecoded;
+	stats.framesConverted = framesConverted;
+	stats.conversionMs = stats.framesConverted > 0 ?
+		conversionMicros / 1000.0 / stats.framesConverted : 0.0;
+	return stats;
+}
+
+double VideoDecoder::getThreadCpuTime() {
+	return ::getThreadCpuTime(decoderThread);
+}
+
+LatenessStats VideoDecoder::getLatenessStats() const {
+	std::lock_guard<std::mutex> lock(latenessMutex);
+	return latenessController.getStats();
+}
 
-	int ret = av_seek_frame(formatContext, videoStreamIndex, timestamp, AVSEEK_FLAG_BACKWARD);
-	if (ret < 0) {
-		std::cerr << "Error seeking to time: " << seconds << std::endl;
+bool VideoDecoder::convertPicture(AVFrame* decoded, VideoPicture* picture, int width, int height) {
+	// Converted pictures recycle buffers that came back from the renderer
+	AVFrame* output = picture->frame;
+	if (!outputPool.getBuffer(output, width, height, outputFormat)) {
+		std::cerr << "Could not allocate picture buffer" << std::endl;
 		return false;
 	}
 
-	// Flush decoder buffers
-	avcodec_flush_buffers(videoCodecContext);
+	// Same-size frames in the announced format go through the SIMD kernels
+	if (colorConverter.isConfigured() && decoded->format == pixelFormat &&
+		decoded->width == width && decoded->height == height) {
+		colorConverter.convert(decoded->data, decoded->linesize,
+			output->data[0], output->linesize[0], height);
+		return true;
+	}
+
+	// Scalers are cached per size, so a resize back reuses the old one
+	SwsContext* swsContext = scalerCache.get(
+		decoded->width, decoded->height, (AVPixelFormat)decoded->format,
+		width, height, outputFormat, getScaleFlags());
+	if (!swsContext) {
+		std::cerr << "Could not create scaling context" << std::endl;
+		av_frame_unref(output);
+		return false;
+	}
+
+	sws_scale(swsContext,
+			(const uint8_t* const*)decoded->data, decoded->linesize,
+			0, decoded->height,
+			output->data, output->linesize);
+	return true;
+}
+
+void VideoDecoder::prepareSeek(double seconds) {
+	// Set while the old packets are still queued: once the demuxer has
+	// seeked, the decoding thread may decode the new keyframe at any time
+	seekTarget = seconds;
+	latenessReset = true;
+}
+
+void VideoDecoder::cancelSeek() {
+	seekTarget = -DBL_MAX;
+}
+
+bool VideoDecoder::seekToTime(double seconds) {
+	if (!isOpen) {
+		return false;
+	}
+
+	// The demuxer has already repositioned the file and flushed the packet
+	// queue; the decoding thread flushes the codec when it sees the new
+	// serial, so only the pictures decoded before the seek need to go
+	pictureQueue.flush();
+	currentPts = seconds;
 	endOfStream = false;
 
 	return true;
 }
 
+const VideoPicture* VideoDecoder::peekPicture() {
+	if (!isOpen) {
+		return nullptr;
+	}
+
+	// Drop pictures decoded from packets queued before a seek
+	int serial = packetQueue->getSerial();
+	VideoPicture* picture;
+	while ((picture = pictureQueue.peek()) && picture->serial != serial) {
+		pictureQueue.pop();
+	}
+	return picture;
+}
+
+const VideoPicture* VideoDecoder::peekNextPicture() {
+	if (!isOpen) {
+		return nullptr;
+	}
+
+	VideoPicture* picture = pictureQueue.peekNext();
+	if (picture && picture->serial != packetQueue->getSerial()) {
+		return nullptr;
+	}
+	return picture;
+}
+
+void VideoDecoder::popPicture() {
+	VideoPicture* picture = pictureQueue.peek();
+	if (picture) {
+		currentPts = picture->pts;
+		pictureQueue.pop();
+	}
+}
+
+bool VideoDecoder::isFullRange() const {
+	if (pixelFormat == AV_PIX_FMT_YUVJ420P) {
+		return true;
+	}
+	return videoStream && videoStream->codecpar->color_range == AVCOL_RANGE_JPEG;
+}
+
+AVColorSpace VideoDecoder::getColorSpace() const {
+	return videoStream ? videoStream->codecpar->color_space : AVCOL_SPC_UNSPECIFIED;
+}
+
 double VideoDecoder::getCurrentTime() const {
-	if (!isOpen || !frame) {
+	if (!isOpen) {
 		return 0.0;
 	}
 
-	return frame->pts * timeBase;
+	return currentPts;
 }
 
 void VideoDecoder::printFileInfo() const {
@@ -294,23 +702,42 @@ void VideoDecoder::printFileInfo() const {
 	std::cout << "Frame Rate: " << frameRate << "fps" << std::endl;
 	std::cout << "Duration: " << getDuration() << "seconds" << std::endl;
 	std::cout << "Pixel Format" << av_get_pix_fmt_name(pixelFormat) << std::endl;
+	std::cout << "Output Format: " << av_get_pix_fmt_name(outputFormat);
+	if (colorConverter.isConfigured()) {
+		std::cout << " (converted, " << colorConverter.getKernelName() << " kernel)" << std::endl;
+	}
+	else {
+		std::cout << (outputFormat != pixelFormat ? " (converted, swscale)" : " (native)") << std::endl;
+	}
+
+	// Report what the codec actually enabled
+	const char* activeType = "none";
+	if (videoCodecContext->active_thread_type & FF_THREAD_FRAME) {
+		activeType = "frame";
+	}
+	else if (videoCodecContext->active_thread_type & FF_THREAD_SLICE) {
+		activeType = "slice";
+	}
+	std::cout << "Threading: " << getThreadingPolicyName(threadingPolicy) << " policy, "
+		<< activeType << " threads x" << videoCodecContext->thread_count << std::endl;
+	std::cout << "Frame Buffers: " << (videoCodecContext->get_buffer2 == FramePool::getCodecBuffer
+		? "pooled" : "codec default") << std::endl;
 	std::cout << "================================" << std::endl;
 }
 
 void VideoDecoder::cleanup() {
-	// Free buffers
-	if (buffer) {
-		av_free(buffer);
-		buffer = nullptr;
+	// Stop the decoding thread
+	shouldStop = true;
+	pictureQueue.abort();
+	if (decoderThread.joinable()) {
+		decoderThread.join();
 	}
+	pictureQueue.release();
 
-	// Free frames
+	// Free frame
 	if (frame) {
 		av_frame_free(&frame);
 	}
-	if (frameRGB) {
-		av_frame_free(&frameRGB);
-	}
 
 	// Free packet
 	if (packet) {
@@ -318,23 +745,33 @@ void VideoDecoder::cleanup() {
 	}
 
 	// Free scaling context
-	if (swsContext) {
-		sws_freeContext(swsContext);
-		swsContext = nullptr;
-	}
+	scalerCache.clear();
+	colorConverter = ColorConverter();
 
 	// Free codec context
 	if (videoCodecContext) {
 		avcodec_free_context(&videoCodecContext);
 	}
 
-	// Free format context
-	if (formatContext) {
-		avformat_close_input(&formatContext);
+	// Every pooled frame has been released by now
+	if (isOpen) {
+		printPoolStats("Decode", decodePool.getStats());
+		printPoolStats("Output", outputPool.getStats());
+		printLatenessStats(latenessController.getStats());
+	}
+	decodePool.reset();
+	outputPool.reset();
+
+	// Stop receiving packets
+	if (demuxer && packetQueue) {
+		demuxer->detachStream(AVMEDIA_TYPE_VIDEO);
 	}
+	packetQueue = nullptr;
+	videoStream = nullptr;
+	demuxer = nullptr;
 
 	// Reset state
-	videoStreamIndex = -1;
+	packetSerial = -1;
 	frameWidth = frameHeight = 0;
 	isOpen = false;
 	endOfStream = false;
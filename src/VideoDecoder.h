@@ -3,67 +3,214 @@
 
 #include <string>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/time.h>
 #include <libswscale/swscale.h>
 }
 
+#include "Demuxer.h"
+#include "PictureQueue.h"
+#include "ColorConverter.h"
+#include "ScalerCache.h"
+#include "FramePool.h"
+#include "LatenessController.h"
+
+// How the codec spreads decoding across cores
+enum class ThreadingPolicy {
+	Auto,	// Picked per codec and resolution
+	Frame,	// Frame threading only
+	Slice,	// Slice threading only
+	Count	// Fixed thread count, codec picks the threading type
+};
+
+// Quality/speed trade-off when pictures are resized
+enum class ScaleFilter {
+	Fast,		// SWS_FAST_BILINEAR
+	Bilinear,	// SWS_BILINEAR
+	Bicubic,	// SWS_BICUBIC
+	Lanczos		// SWS_LANCZOS
+};
+
+struct VideoDecodeStats {
+	uint64_t framesDecoded;
+	uint64_t framesConverted;	// Scaled or converted rather than passed through
+	double conversionMs;		// Average per converted frame
+};
+
 class VideoDecoder {
 private:
-	// FFmpeg components
-	AVFormatContext* formatContext;
+	// FFmpeg components (the format context belongs to the demuxer)
+	Demuxer* demuxer;
+	PacketQueue* packetQueue;
+	AVStream* videoStream;
 	AVCodecContext* videoCodecContext;
 	const AVCodec* videoCodec;
 	AVFrame* frame;
-	AVFrame* frameRGB;
 	AVPacket* packet;
-	struct SwsContext* swsContext;
+	ScalerCache scalerCache;
 
 	// Video stream info
-	int videoStreamIndex;
+	int packetSerial;
 	int frameWidth;
 	int frameHeight;
 	AVPixelFormat pixelFormat;
 
-	// Buffer for RGB conversion
-	uint8_t* buffer;
-	int bufferSize;
+	// Output format handed to the renderer
+	bool nativeOutput;
+	AVPixelFormat outputFormat;
+
+	// Output size requested by the renderer (0 = source size)
+	std::mutex outputMutex;
+	int targetWidth;
+	int targetHeight;
+	std::atomic<ScaleFilter> scaleFilter;
+
+	// Built-in SIMD kernels used instead of swscale where they apply
+	bool simdConversion;
+	ColorConverter colorConverter;
+
+	// Reproducible output for checksum runs
+	bool bitexact;
+
+	// Decoder threading
+	ThreadingPolicy threadingPolicy;
+	int requestedThreads;
+
+	// Recycled buffers for decoded and converted pictures; declared before
+	// the picture queue so they outlive the frames it references
+	FramePool decodePool;
+	FramePool outputPool;
+
+	// Converted pictures waiting for presentation
+	PictureQueue pictureQueue;
 
 	// Timing info
 	double timeBase;
 	double frameRate;
 	int64_t duration;
+	double nextPts;
+	std::atomic<double> currentPts;
+	std::atomic<double> seekTarget;	// Pictures before it are dropped
+	std::atomic<int64_t> firstPictureTime;
+	uint64_t pictureSequence;	// Decoding thread only, never reset
+
+	// Decode statistics, written by the decoding thread
+	std::atomic<uint64_t> framesDecoded;
+	std::atomic<uint64_t> framesConverted;
+	std::atomic<int64_t> conversionMicros;
+
+	// Master clock published by the renderer, extrapolated while running
+	std::atomic<double> masterClock;
+	std::atomic<int64_t> masterClockUpdated;
+	std::atomic<bool> masterClockRunning;
+
+	// Work shed when decoding falls behind the clock
+	LatenessController latenessController;
+	mutable std::mutex latenessMutex;
+	std::atomic<bool> latenessReset;
+	LateStage appliedStage;
+
+	// Threading
+	std::thread decoderThread;
+	std::atomic<bool> shouldStop;
 
 	// State
 	bool isOpen;
-	bool endOfStream;
+	std::atomic<bool> endOfStream;
 
 	// Private methods
 	bool findVideoStream();
 	bool setupDecoder();
+	void configureThreading();
 	bool setupScaler();
+	bool convertPicture(AVFrame* decoded, VideoPicture* picture, int width, int height);
+	void getOutputSize(int& width, int& height);
+	int getScaleFlags() const;
 	void calculateTiming();
 	void cleanup();
+	void decodingLoop();
+	bool queuePicture(AVFrame* decoded);
+	bool checkLateness(double pts, double frameDuration);
+	void applyLateStage(LateStage stage);
 
 public:
 	VideoDecoder();
 	~VideoDecoder();
 
+	// Threading policy, applied on the next OpenStream (0 threads = per core)
+	void setThreadingPolicy(ThreadingPolicy policy, int threads = 0);
+	ThreadingPolicy getThreadingPolicy() const { return threadingPolicy; }
+
+	static const char* getThreadingPolicyName(ThreadingPolicy policy);
+	// "auto", "frame", "slice" or "count"
+	static bool parseThreadingPolicy(const std::string& name, ThreadingPolicy& policy);
+
+	// Native output hands YUV420P/NV12/NV21 frames over without conversion,
+	// applied on the next OpenStream; other formats are converted to RGB24
+	void setNativeOutput(bool enabled) { nativeOutput = enabled; }
+	void setSimdConversion(bool enabled) { simdConversion = enabled; }
+	// Bit-exact decoding and scaling, applied on the next OpenStream
+	void setBitexact(bool enabled) { bitexact = enabled; }
+
+	// Pictures are scaled down to the size they are displayed at; the
+	// renderer scales up itself, so larger sizes keep the source size
+	void setOutputSize(int width, int height);
+	void setScaleFilter(ScaleFilter filter) { scaleFilter = filter; }
+
+	// Clock pictures are presented by (render thread); late frames are
+	// measured against it and work is shed in stages to catch up
+	void updateMasterClock(double seconds, bool running);
+	LatenessStats getLatenessStats() const;
+
+	// When the first picture since opening was queued,
+	// av_gettime_relative() microseconds, or -1
+	int64_t getFirstPictureTime() const { return firstPictureTime; }
+
+	// Decoded and converted frame counts since opening
+	VideoDecodeStats getDecodeStats() const;
+
+	// CPU seconds used by the decoding thread while it runs; the codec's
+	// own worker threads are not included
+	double getThreadCpuTime();
+
 	// Main interface
-	bool OpenFile(const std::string& filename);
-	bool getNextFrame(uint8_t** rgbData, int& width, int& height);
+	bool OpenStream(Demuxer& demuxer);
+	// Seeking is two steps around the demuxer seek: prepareSeek sets the
+	// target before the first packet of the new position can be decoded,
+	// seekToTime drops the pictures decoded before it. cancelSeek undoes
+	// prepareSeek when the demuxer could not seek.
+	void prepareSeek(double seconds);
+	void cancelSeek();
 	bool seekToTime(double seconds);
 	void close();
 
+	// Decoded pictures (render thread); stale pictures from before a seek
+	// are skipped, popping a picture marks it as the one on screen
+	const VideoPicture* peekPicture();
+	const VideoPicture* peekNextPicture();
+	void popPicture();
+	int getQueuedPictures() const { return pictureQueue.size(); }
+
+	// Buffer reuse of the codec and conversion pools
+	FramePoolStats getDecodePoolStats() const { return decodePool.getStats(); }
+	FramePoolStats getOutputPoolStats() const { return outputPool.getStats(); }
+
 	// Getters
 	bool isFileOpen() const { return isOpen; }
-	bool hasEnded() const { return endOfStream; }
+	bool hasEnded() const { return endOfStream && pictureQueue.size() == 0; }
 	int getWidth() const { return frameWidth; }
 	int getHeight() const { return frameHeight; }
+	AVPixelFormat getOutputFormat() const { return outputFormat; }
+	bool isFullRange() const;
+	AVColorSpace getColorSpace() const;
 	double getDuration() const{ return duration * timeBase; }
 	double getFrameRate() const { return frameRate; }
 	double getCurrentTime() const;
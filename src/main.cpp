@@ -1,26 +1,222 @@
 // Aplication entry point
 #include <iostream>
 #include <memory>
+#include <string>
+#include <cstring>
+#include <cstdlib>
 #include <SDL.h>
 #include "MediaPlayer.h"
+#include "Benchmarks.h"
+#include "Tracer.h"
+#include "FrameHash.h"
+#include "Logger.h"
 
 #ifdef _WIN32
 #undef main // Fix SDL2 main redefinition issue on Windows
 #endif
 
 int main(int argc, char* argv[]) {
+	// Audio ring stress benchmark, no window or device needed
+	if (argc > 1 && strcmp(argv[1], "--ring-stress") == 0) {
+		double seconds = argc > 2 ? atof(argv[2]) : 10.0;
+		return runSampleRingStress(seconds) ? 0 : 1;
+	}
+
+	// A/V sync simulation on synthetic streams
+	if (argc > 1 && strcmp(argv[1], "--sync-sim") == 0) {
+		return runSyncSimulation() ? 0 : 1;
+	}
+
+	// SIMD colour conversion kernels against each other and swscale
+	if (argc > 1 && strcmp(argv[1], "--color-check") == 0) {
+		return runColorConversionCheck() ? 0 : 1;
+	}
+
+	// Decode-only throughput for each thread count
+	if (argc > 1 && strcmp(argv[1], "--decode-bench") == 0) {
+		ThreadingPolicy policy = ThreadingPolicy::Auto;
+		if (argc < 3 || (argc > 4 && !VideoDecoder::parseThreadingPolicy(argv[4], policy))) {
+			std::cerr << "usage: MediaPlayer --decode-bench file [seconds] [auto|frame|slice|count]" << std::endl;
+			return -1;
+		}
+		double seconds = argc > 3 ? atof(argv[3]) : 10.0;
+		return runDecodeBenchmark(argv[2], policy, seconds) ? 0 : 1;
+	}
+
+	// Checksum files of two runs, first differing frame reported
+	if (argc > 1 && strcmp(argv[1], "--compare") == 0) {
+		if (argc < 4) {
+			std::cerr << "usage: MediaPlayer --compare expected actual" << std::endl;
+			return -1;
+		}
+		return compareFrameHashes(argv[2], argv[3]) ? 0 : 1;
+	}
+
+	// Hot paths log through a ring written out by a background thread
+	Logger::start();
+
 	try {
 		MediaPlayer player;
 
+		// Command line: [file] [options]; a file opens and plays right away
+		std::string file;
+		RunOptions run;
+		DecoderOptions decoders;
+		bool tracing = false;
+		bool sinkOutput = false;
+		std::string hashPath;
+		HashAlgorithm hashAlgorithm = HashAlgorithm::XXH64;
+		for (int i = 1; i < argc; i++) {
+			// Play as soon as a file is open, audio device set up alongside
+			if (strcmp(argv[i], "--fast-start") == 0) {
+				player.setFastStart(true);
+			}
+			// Pipeline spans, written on exit; needs a MEDIAPLAYER_TRACING build
+			else if (strcmp(argv[i], "--trace") == 0) {
+#if MEDIAPLAYER_TRACING
+				TRACE_START();
+				tracing = true;
+#else
+				std::cerr << "--trace: built without MEDIAPLAYER_TRACING" << std::endl;
+#endif
+			}
+			else if (strcmp(argv[i], "--headless") == 0) {
+				run.headless = true;
+			}
+			else if (strcmp(argv[i], "--bench") == 0) {
+				run.bench = true;
+			}
+			else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+				run.duration = atof(argv[++i]);
+			}
+			else if (strcmp(argv[i], "--seek-test") == 0) {
+				run.seekTest = true;
+			}
+			else if (strcmp(argv[i], "--loop") == 0) {
+				run.loop = true;
+			}
+			// Fails the run if steady-state playback allocates
+			else if (strcmp(argv[i], "--alloc-check") == 0) {
+				run.allocationCheck = true;
+			}
+			else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+				decoders.videoThreads = atoi(argv[++i]);
+			}
+			// Frame or slice threading instead of the per-codec choice
+			else if (strcmp(argv[i], "--threading") == 0 && i + 1 < argc) {
+				if (!VideoDecoder::parseThreadingPolicy(argv[++i], decoders.threadingPolicy)) {
+					std::cerr << "--threading: auto, frame, slice or count" << std::endl;
+					return -1;
+				}
+			}
+			// Audio device buffer in sample frames, or grown on underruns
+			else if (strcmp(argv[i], "--audio-latency") == 0 && i + 1 < argc) {
+				if (!AudioDecoder::parseLatency(argv[++i], decoders.audioLatency)) {
+					std::cerr << "--audio-latency: 256, 512, 1024, 4096 or adaptive" << std::endl;
+					return -1;
+				}
+			}
+			// Pictures and samples to null, .y4m, raw or .wav outputs
+			// instead of the screen and speakers; these run as benchmarks
+			else if (strcmp(argv[i], "--video-out") == 0 && i + 1 < argc) {
+				player.setVideoSink(createVideoSink(argv[++i]));
+				sinkOutput = true;
+				run.bench = true;
+			}
+			else if (strcmp(argv[i], "--audio-out") == 0 && i + 1 < argc) {
+				player.setAudioSink(createAudioSink(argv[++i]));
+				sinkOutput = true;
+				run.bench = true;
+			}
+			// Per-frame checksums in framemd5 layout, to tell runs apart
+			else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc) {
+				hashPath = argv[++i];
+				run.bench = true;
+			}
+			else if (strcmp(argv[i], "--hash-algorithm") == 0 && i + 1 < argc) {
+				if (!FrameHash::parseAlgorithm(argv[++i], hashAlgorithm)) {
+					std::cerr << "--hash-algorithm: xxh64 or md5" << std::endl;
+					return -1;
+				}
+			}
+			// Same output on every run and machine: one decode thread,
+			// bit-exact codecs and scaling
+			else if (strcmp(argv[i], "--deterministic") == 0) {
+				decoders.videoThreads = 1;
+				decoders.bitexact = true;
+			}
+			else if (strcmp(argv[i], "--no-simd") == 0) {
+				decoders.simdConversion = false;
+			}
+			else if (argv[i][0] != '-') {
+				file = argv[i];
+			}
+			else {
+				std::cerr << "unknown option: " << argv[i] << std::endl;
+				std::cerr << "usage: MediaPlayer [file] [--headless] [--bench] [--duration seconds] "
+					"[--seek-test] [--loop] [--alloc-check] [--threads count] [--threading auto|frame|slice|count] "
+					"[--audio-latency 256|512|1024|4096|adaptive] [--video-out null|file.y4m|file] "
+					"[--audio-out null|file.wav] [--hash file] [--hash-algorithm xxh64|md5] "
+					"[--deterministic] [--no-simd] [--fast-start] [--trace]" << std::endl;
+				std::cerr << "       MediaPlayer --compare expected actual" << std::endl;
+				std::cerr << "       MediaPlayer --ring-stress [seconds] | --sync-sim | --color-check" << std::endl;
+				std::cerr << "       MediaPlayer --decode-bench file [seconds] [auto|frame|slice|count]" << std::endl;
+				return -1;
+			}
+		}
+
+		// Both sinks share one checksum file, which takes the place of any
+		// other output
+		if (!hashPath.empty() && sinkOutput) {
+			std::cerr << "--hash cannot be combined with --video-out or --audio-out" << std::endl;
+			return -1;
+		}
+		if (!hashPath.empty()) {
+			auto writer = std::make_shared<FrameHashWriter>(hashPath, hashAlgorithm);
+			player.setVideoSink(std::make_unique<HashVideoSink>(writer));
+			player.setAudioSink(std::make_unique<HashAudioSink>(writer));
+		}
+
+		// Unattended runs end by themselves and report what they measured
+		if ((run.headless || run.bench || run.allocationCheck) && file.empty()) {
+			std::cerr << "--headless, --bench and --alloc-check need a file to play" << std::endl;
+			return -1;
+		}
+		if (!file.empty()) {
+			run.summary = true;
+			run.exitAtEnd = run.headless || run.bench || run.duration > 0.0;
+		}
+		player.setRunOptions(run);
+		player.setDecoderOptions(decoders);
+
 		if (!player.initialize()) {
 			std::cerr << "failed to initialize media player" << std::endl;
 			return -1;
 		}
 
+		if (!file.empty()) {
+			if (!player.openFile(file)) {
+				std::cerr << "failed to open " << file << std::endl;
+				player.cleanup();
+				return 1;
+			}
+			player.play();
+		}
+
 		// main application loop
 		player.run();
 
 		player.cleanup();
+		Logger::stop();
+		if (tracing) {
+			TRACE_WRITE("mediaplayer_trace.json", "mediaplayer_frames.csv");
+		}
+
+		if (run.allocationCheck) {
+			const RunStats& stats = player.getRunStats();
+			bool passed = stats.allocationsCounted && stats.steadyAllocations == 0 && stats.steadyPoolBuffers == 0;
+			return passed ? 0 : 1;
+		}
 		return 0;
 	}
 	catch (const std::exception& e) {